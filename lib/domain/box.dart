@@ -132,6 +132,17 @@ class Box {
     }
   }
 
+  /// Returns whether a node with the given [nodeId] exists.
+  ///
+  /// Cheaper than [loadNode] for existence checks: nothing is read or
+  /// deserialized, and most missing ids are ruled out from memory.
+  bool containsNode(String nodeId) {
+    final ptr = nodeId.toNativeUtf8().cast<ffi.Char>();
+    final result = _bindings.graphdb_contains_node(_handle, ptr);
+    malloc.free(ptr);
+    return result != 0;
+  }
+
   /// Saves an edge to the graph database.
   ///
   /// The [edge] represents a connection between two nodes and will be
@@ -196,4 +207,79 @@ class Box {
       return [];
     }
   }
+
+  /// Hit and miss counts of the cache behind [loadEdges] since the box was opened.
+  ///
+  /// A low hit ratio on a read-heavy workload means the hot adjacency lists do
+  /// not fit the cache.
+  ({int hits, int misses}) edgeCacheStats() {
+    final hits = malloc<ffi.UnsignedLongLong>();
+    final misses = malloc<ffi.UnsignedLongLong>();
+    try {
+      _bindings.graphdb_edge_cache_stats(_handle, hits, misses);
+      return (hits: hits.value, misses: misses.value);
+    } finally {
+      malloc.free(hits);
+      malloc.free(misses);
+    }
+  }
+
+  /// Reclaims the space of deleted and overwritten nodes right away.
+  ///
+  /// Compaction normally runs on a background thread; call this after a large
+  /// batch of deletes to shrink the database without waiting for it.
+  void compact() {
+    _bindings.graphdb_compact(_handle);
+  }
+
+  /// Turns block compression of sealed chunks on or off (off by default).
+  ///
+  /// While it is on, the background compactor rewrites chunks that no longer
+  /// take new records as compressed blocks, trading some read CPU for disk space.
+  void setChunkCompression(bool enabled) {
+    _bindings.graphdb_set_chunk_compression(_handle, enabled ? 1 : 0);
+  }
+
+  /// Writes every edge of the box into its CSR snapshot file (`graph.csr`).
+  ///
+  /// The snapshot serves whole-graph scans from one sequential file instead of
+  /// the edge chunks. Returns the number of edges written, or -1 on failure.
+  int sealSnapshot() {
+    return _bindings.graphdb_seal_snapshot(_handle);
+  }
+
+  /// Loads the edges of [fromNodeId] as of the last [sealSnapshot].
+  ///
+  /// Reads the mapped snapshot file rather than the edge chunks, so edges saved
+  /// after the seal are not included and edge properties are not kept. The
+  /// [serializer] is used as in [loadEdges].
+  ///
+  /// Returns an empty list if there is no snapshot, the node is not in it, or
+  /// deserialization fails.
+  List<T> loadSnapshotEdges<T>(
+    String fromNodeId, {
+    required T Function(Map<String, dynamic>) serializer,
+  }) {
+    final ptr = fromNodeId.toNativeUtf8().cast<ffi.Char>();
+    final resultPtr = _bindings.graphdb_load_snapshot_edges(_handle, ptr);
+    malloc.free(ptr);
+
+    if (resultPtr == ffi.nullptr) {
+      log('loadSnapshotEdges: No snapshot edges for node id: $fromNodeId');
+      return [];
+    }
+
+    try {
+      final result = resultPtr.cast<Utf8>().toDartString();
+      _bindings.graphdb_free_string(resultPtr);
+      final jsonData = jsonDecode(result) as List<dynamic>;
+      return jsonData
+          .map((item) => serializer(item as Map<String, dynamic>))
+          .toList();
+    } catch (e) {
+      _bindings.graphdb_free_string(resultPtr);
+      log('loadSnapshotEdges: Error deserializing edges for node id $fromNodeId: $e');
+      return [];
+    }
+  }
 }
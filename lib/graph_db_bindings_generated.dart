@@ -93,6 +93,23 @@ class GraphDbBindings {
         ffi.Pointer<ffi.Char> Function(ffi.Pointer<Box>, ffi.Pointer<ffi.Char>)
       >();
 
+  /// Check whether a node exists without loading it (1 = exists, 0 = not found)
+  int graphdb_contains_node(
+    ffi.Pointer<Box> box,
+    ffi.Pointer<ffi.Char> nodeId,
+  ) {
+    return _graphdb_contains_node(box, nodeId);
+  }
+
+  late final _graphdb_contains_nodePtr =
+      _lookup<
+        ffi.NativeFunction<
+          ffi.Int Function(ffi.Pointer<Box>, ffi.Pointer<ffi.Char>)
+        >
+      >('graphdb_contains_node');
+  late final _graphdb_contains_node = _graphdb_contains_nodePtr
+      .asFunction<int Function(ffi.Pointer<Box>, ffi.Pointer<ffi.Char>)>();
+
   /// Load edges for a node (returns malloc'ed JSON string)
   ffi.Pointer<ffi.Char> graphdb_load_edges(
     ffi.Pointer<Box> box,
@@ -115,6 +132,34 @@ class GraphDbBindings {
         ffi.Pointer<ffi.Char> Function(ffi.Pointer<Box>, ffi.Pointer<ffi.Char>)
       >();
 
+  /// Hit and miss counts of the cache behind graphdb_load_edges since the box was opened
+  void graphdb_edge_cache_stats(
+    ffi.Pointer<Box> box,
+    ffi.Pointer<ffi.UnsignedLongLong> hits,
+    ffi.Pointer<ffi.UnsignedLongLong> misses,
+  ) {
+    return _graphdb_edge_cache_stats(box, hits, misses);
+  }
+
+  late final _graphdb_edge_cache_statsPtr =
+      _lookup<
+        ffi.NativeFunction<
+          ffi.Void Function(
+            ffi.Pointer<Box>,
+            ffi.Pointer<ffi.UnsignedLongLong>,
+            ffi.Pointer<ffi.UnsignedLongLong>,
+          )
+        >
+      >('graphdb_edge_cache_stats');
+  late final _graphdb_edge_cache_stats = _graphdb_edge_cache_statsPtr
+      .asFunction<
+        void Function(
+          ffi.Pointer<Box>,
+          ffi.Pointer<ffi.UnsignedLongLong>,
+          ffi.Pointer<ffi.UnsignedLongLong>,
+        )
+      >();
+
   /// Build indexes manually (optional, usually called internally)
   void graphdb_build_node_index(ffi.Pointer<Box> box) {
     return _graphdb_build_node_index(box);
@@ -138,6 +183,66 @@ class GraphDbBindings {
   late final _graphdb_build_edge_index = _graphdb_build_edge_indexPtr
       .asFunction<void Function(ffi.Pointer<Box>)>();
 
+  /// Reclaim space left by deleted nodes right away (normally done on a background thread)
+  void graphdb_compact(ffi.Pointer<Box> box) {
+    return _graphdb_compact(box);
+  }
+
+  late final _graphdb_compactPtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Pointer<Box>)>>(
+        'graphdb_compact',
+      );
+  late final _graphdb_compact = _graphdb_compactPtr
+      .asFunction<void Function(ffi.Pointer<Box>)>();
+
+  /// Store sealed chunks block-compressed from now on (0 = off, the default)
+  void graphdb_set_chunk_compression(ffi.Pointer<Box> box, int enabled) {
+    return _graphdb_set_chunk_compression(box, enabled);
+  }
+
+  late final _graphdb_set_chunk_compressionPtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Pointer<Box>, ffi.Int)>>(
+        'graphdb_set_chunk_compression',
+      );
+  late final _graphdb_set_chunk_compression = _graphdb_set_chunk_compressionPtr
+      .asFunction<void Function(ffi.Pointer<Box>, int)>();
+
+  /// Export all edges into the box's CSR snapshot file (graph.csr) for whole-graph scans.
+  /// Returns the number of edges written, or -1 on failure.
+  int graphdb_seal_snapshot(ffi.Pointer<Box> box) {
+    return _graphdb_seal_snapshot(box);
+  }
+
+  late final _graphdb_seal_snapshotPtr =
+      _lookup<ffi.NativeFunction<ffi.LongLong Function(ffi.Pointer<Box>)>>(
+        'graphdb_seal_snapshot',
+      );
+  late final _graphdb_seal_snapshot = _graphdb_seal_snapshotPtr
+      .asFunction<int Function(ffi.Pointer<Box>)>();
+
+  /// Load a node's edges as of the last sealed snapshot, read from the mapped file
+  /// (returns malloc'ed JSON string, NULL when there is no snapshot or the node is not in it)
+  ffi.Pointer<ffi.Char> graphdb_load_snapshot_edges(
+    ffi.Pointer<Box> box,
+    ffi.Pointer<ffi.Char> nodeId,
+  ) {
+    return _graphdb_load_snapshot_edges(box, nodeId);
+  }
+
+  late final _graphdb_load_snapshot_edgesPtr =
+      _lookup<
+        ffi.NativeFunction<
+          ffi.Pointer<ffi.Char> Function(
+            ffi.Pointer<Box>,
+            ffi.Pointer<ffi.Char>,
+          )
+        >
+      >('graphdb_load_snapshot_edges');
+  late final _graphdb_load_snapshot_edges = _graphdb_load_snapshot_edgesPtr
+      .asFunction<
+        ffi.Pointer<ffi.Char> Function(ffi.Pointer<Box>, ffi.Pointer<ffi.Char>)
+      >();
+
   /// Estimate node chunk size from JSON (returns size in bytes)
   int graphdb_estimate_nodes_size(
     ffi.Pointer<Box> box,
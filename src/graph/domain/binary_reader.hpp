@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+
+using namespace std;
+
+namespace graphdb
+{
+    // Cursor that decodes records in place from encoded bytes - a mapped chunk, a
+    // window of decoded blocks or a WAL payload. Strings come back as views into
+    // those bytes. Running past the end sets a sticky failure flag instead of
+    // throwing. Positions are reported from `base`, so a reader over part of a
+    // chunk still speaks in chunk offsets.
+    class BinaryReader
+    {
+    public:
+        BinaryReader() = default;
+        explicit BinaryReader(span<const byte> bytes, size_t base = 0) : bytes(bytes), base(base) {}
+        explicit BinaryReader(string_view bytes, size_t base = 0) : BinaryReader(as_bytes(span(bytes.data(), bytes.size())), base) {}
+
+        bool good() const { return !failed; }
+        explicit operator bool() const { return !failed; }
+        void fail() { failed = true; }
+
+        size_t tell() const { return base + position; }
+        size_t end() const { return base + bytes.size(); }
+        size_t remaining() const { return bytes.size() - position; }
+
+        void seek(size_t offset)
+        {
+            if (offset < base || offset - base > bytes.size())
+                failed = true;
+            else
+                position = offset - base;
+        }
+
+        void skip(size_t count)
+        {
+            if (count > remaining())
+            {
+                failed = true;
+                position = bytes.size();
+                return;
+            }
+            position += count;
+        }
+
+        // The next count bytes, or an empty view on a short read
+        string_view readBytes(size_t count)
+        {
+            if (count > remaining())
+            {
+                failed = true;
+                position = bytes.size();
+                return {};
+            }
+            string_view view(reinterpret_cast<const char *>(bytes.data()) + position, count);
+            position += count;
+            return view;
+        }
+
+        template <typename T>
+        T readRaw()
+        {
+            T value{};
+            string_view raw = readBytes(sizeof(T));
+            if (raw.size() == sizeof(T))
+                memcpy(&value, raw.data(), sizeof(T));
+            return value;
+        }
+
+        // Reader over the chunk offsets [from, to), which must lie inside this one
+        BinaryReader slice(size_t from, size_t to) const
+        {
+            if (from < base || to < from || to - base > bytes.size())
+            {
+                BinaryReader broken;
+                broken.failed = true;
+                return broken;
+            }
+            return BinaryReader(bytes.subspan(from - base, to - from), from);
+        }
+
+    private:
+        span<const byte> bytes;
+        size_t base = 0;
+        size_t position = 0;
+        bool failed = false;
+    };
+}
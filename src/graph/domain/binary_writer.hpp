@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+namespace graphdb
+{
+    // Growable contiguous buffer that records are encoded into. A whole batch is
+    // built in memory and reaches its file with a single write instead of one
+    // stream call per field.
+    class BinaryWriter
+    {
+    public:
+        void write(const void *data, size_t size) { bytes.append(static_cast<const char *>(data), size); }
+        void put(char byte) { bytes.push_back(byte); }
+
+        template <typename T>
+        void writeRaw(const T &value) { write(&value, sizeof(value)); }
+
+        // Inserts bytes in front of ones already written, e.g. a length prefix
+        // that is only known once the body it measures is encoded
+        void insert(size_t offset, const void *data, size_t size) { bytes.insert(offset, static_cast<const char *>(data), size); }
+
+        void reserve(size_t size) { bytes.reserve(size); }
+        void clear() { bytes.clear(); }
+
+        size_t size() const { return bytes.size(); }
+        const char *data() const { return bytes.data(); }
+        const string &str() const { return bytes; }
+
+    private:
+        string bytes;
+    };
+}
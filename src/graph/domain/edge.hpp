@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include "property.hpp"
 
@@ -16,10 +17,25 @@ namespace graphdb
 
         void print() const;
 
-        void serialize(ostream &out) const;
-        static Edge deserialize(istream &in);
+        void serialize(BinaryWriter &out, RecordFormat format = RecordFormat::V1, RecordDictionaries *dicts = nullptr) const;
+        static Edge deserialize(BinaryReader &in, RecordFormat format = RecordFormat::V1, const RecordDictionaries *dicts = nullptr);
 
         string to_json() const;
         static Edge from_json(const string &jsonStr);
     };
+
+    // An edge record decoded in place, like NodeView: the ids point into the encoded
+    // bytes and the properties stay encoded
+    struct EdgeView
+    {
+        string_view from;
+        string_view to;
+        double weight;
+        // The property count and entries of the record
+        BinaryReader encodedProperties;
+        RecordFormat format;
+
+        // Leaves `in` after the record; properties are stepped over, never decoded
+        static EdgeView read(BinaryReader &in, RecordFormat format);
+    };
 }
\ No newline at end of file
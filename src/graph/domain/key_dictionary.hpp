@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "record_format.hpp"
+
+using namespace std;
+
+namespace graphdb
+{
+    // Interned property keys of a box. From RecordFormat::V3 on, records store a
+    // key's id instead of its bytes; ids are handed out in first-seen order and
+    // never change, so the table only grows.
+    class KeyDictionary
+    {
+    public:
+        // Returns the key's id, assigning the next one when the key is new
+        uint32_t intern(const string &key);
+
+        // Interned key for an id, or null when the id was never assigned.
+        // The string stays valid for the lifetime of the dictionary.
+        const string *key(uint32_t id) const;
+        size_t size() const;
+
+        // Keys with ids in [from, size()), for persisting newly interned entries
+        vector<string> keysFrom(size_t from) const;
+
+    private:
+        mutable shared_mutex keysMutex;
+        // deque: growing never moves the strings handed out by key()
+        deque<string> keys;
+        unordered_map<string, uint32_t> ids;
+    };
+
+    const uint32_t NO_KEY_ID = UINT32_MAX;
+
+    // Key of a property entry: length + bytes up to V2, a dictionary id from V3 on.
+    // Returns the id written, or NO_KEY_ID before V3.
+    uint32_t writeKey(BinaryWriter &out, const string &key, RecordFormat format, KeyDictionary *keys);
+    // View of the key in the record bytes or in the dictionary, whose keys never move.
+    // Fails the reader on an id the dictionary does not know.
+    string_view readKey(BinaryReader &in, RecordFormat format, const KeyDictionary *keys);
+    void skipKey(BinaryReader &in, RecordFormat format);
+}
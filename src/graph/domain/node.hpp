@@ -1,6 +1,7 @@
 #pragma once
 #include <any>
 #include <string>
+#include <string_view>
 #include "property.hpp"
 
 using namespace std;
@@ -14,10 +15,23 @@ namespace graphdb
         PropertyMap properties;
 
         void print() const;
-        void serialize(ostream& out) const;
-        static Node deserialize(istream& in);
+        void serialize(BinaryWriter& out, RecordFormat format = RecordFormat::V1, RecordDictionaries* dicts = nullptr) const;
+        static Node deserialize(BinaryReader& in, RecordFormat format = RecordFormat::V1, const RecordDictionaries* dicts = nullptr);
 
         string to_json() const;
         static Node from_json(const string& jsonStr);
     };
+
+    // A node record decoded in place: the id points into the encoded bytes and the
+    // properties stay encoded. Valid only as long as those bytes are.
+    struct NodeView
+    {
+        string_view id;
+        // The property count and entries of the record
+        BinaryReader encodedProperties;
+        RecordFormat format;
+
+        // Leaves `in` after the record; properties are stepped over, never decoded
+        static NodeView read(BinaryReader& in, RecordFormat format);
+    };
 }
\ No newline at end of file
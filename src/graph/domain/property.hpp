@@ -5,6 +5,8 @@
 #include <memory>
 #include <iostream>
 #include "json.hpp"
+#include "record_format.hpp"
+#include "record_dictionaries.hpp"
 
 using namespace std;
 namespace graphdb
@@ -14,7 +16,8 @@ namespace graphdb
     using PropertyMap = unordered_map<string, PropertyValue>;
 
     struct PropertyValue {
-        using variant_type = variant<int, double, string, bool, shared_ptr<PropertyMap>>;
+        // SharedString holds string values decoded from the value dictionary
+        using variant_type = variant<int, double, string, bool, shared_ptr<PropertyMap>, SharedString>;
         variant_type value;
 
         //default
@@ -25,13 +28,28 @@ namespace graphdb
         PropertyValue(double v) : value(v) {}
         PropertyValue(const string& v) : value(v) {}
         PropertyValue(bool v) : value(v) {}
+        PropertyValue(SharedString v) : value(move(v)) {}
+
+        // The string value in either representation; null for other types
+        const string* asString() const;
 
         size_t estimateSize() const;
 
-        void serialize(ostream& out) const;
-        static PropertyValue deserialize(istream& in);
+        // dicts is required from RecordFormat::V3 on
+        void serialize(BinaryWriter& out, RecordFormat format = RecordFormat::V1, RecordDictionaries* dicts = nullptr) const;
+        static PropertyValue deserialize(BinaryReader& in, RecordFormat format = RecordFormat::V1, const RecordDictionaries* dicts = nullptr);
 
         nlohmann::json to_json() const;
         static PropertyValue from_json(const nlohmann::json& j);
     };
+
+    // One entry of a property map, key first. From V4 on, string values of
+    // low-cardinality keys are written as value dictionary ids.
+    void writeProperty(BinaryWriter& out, const string& key, const PropertyValue& value, RecordFormat format, RecordDictionaries* dicts);
+    // An entry count followed by that many entries, as in records and nested maps
+    void readProperties(BinaryReader& in, RecordFormat format, const RecordDictionaries* dicts, PropertyMap& properties);
+
+    // Advances past one value by its type tag without decoding it; used to step
+    // over records written before V5, which carry no length
+    void skipValue(BinaryReader& in, RecordFormat format);
 }
\ No newline at end of file
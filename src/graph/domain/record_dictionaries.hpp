@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include "key_dictionary.hpp"
+#include "value_dictionary.hpp"
+
+using namespace std;
+
+namespace graphdb
+{
+    struct PropertyValue;
+    using PropertyMap = unordered_map<string, PropertyValue>;
+
+    // Box-wide tables that records of format V3 and later refer to by id
+    struct RecordDictionaries
+    {
+        KeyDictionary keys;
+        ValueDictionary values;
+
+        // Interns every key of the map, nested maps included, and passes every string
+        // value through ValueDictionary::encode, so whatever a record will refer to
+        // can be persisted before the record is written
+        void internAll(const PropertyMap &properties);
+    };
+}
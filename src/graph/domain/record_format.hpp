@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include "binary_writer.hpp"
+#include "binary_reader.hpp"
+
+using namespace std;
+
+namespace graphdb
+{
+    // Encoding of Node / Edge / PropertyValue records.
+    // V1 writes every length as a native size_t, V2 as an unsigned LEB128 varint.
+    // V3 is V2 with property keys replaced by ids from the box's KeyDictionary,
+    // V4 adds string values stored as ids from the box's ValueDictionary.
+    // V5 prefixes every Node / Edge record with the byte length of the rest of it;
+    // a node body may end early, padded by an in-place upsert.
+    enum class RecordFormat : uint8_t
+    {
+        V1 = 1,
+        V2 = 2,
+        V3 = 3,
+        V4 = 4,
+        V5 = 5,
+    };
+
+    const RecordFormat CURRENT_RECORD_FORMAT = RecordFormat::V5;
+
+    void writeLength(BinaryWriter &out, size_t value, RecordFormat format);
+    // Fails the reader on a truncated or overlong varint
+    size_t readLength(BinaryReader &in, RecordFormat format);
+}
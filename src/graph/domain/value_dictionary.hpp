@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace graphdb
+{
+    // Immutable string shared by every decoded record that holds the same dictionary value
+    using SharedString = shared_ptr<const string>;
+
+    // Frequent string property values of a box. From RecordFormat::V4 on, a string
+    // value found here is stored as its id. Each key is sampled first: its values
+    // stay inline until MIN_SAMPLES of them have been seen. If they held at most
+    // MAX_VALUES_PER_KEY distinct values, the key's values are collected from then
+    // on (status / country / type style properties); a key that goes past that
+    // limit while sampled (names, emails, ids, free text) stays inline for good
+    // and never gets an entry.
+    class ValueDictionary
+    {
+    public:
+        // Counts the value towards its key's sample and returns its id, interning
+        // it once the key is known to be low-cardinality; nullopt when it stays inline
+        optional<uint32_t> encode(uint32_t keyId, const string &value);
+        // Id of an entry that already exists; never adds one
+        optional<uint32_t> find(uint32_t keyId, const string &value) const;
+
+        // Adds a persisted entry back, bypassing the sampling and the limits
+        void restore(uint32_t keyId, const string &value);
+
+        // Shared value for an id, or null when the id was never assigned
+        SharedString value(uint32_t id) const;
+        size_t size() const;
+
+        // (key id, value) of entries with ids in [from, size()), for persisting new entries
+        vector<pair<uint32_t, string>> entriesFrom(size_t from) const;
+
+        // A key stops collecting values once it has this many distinct ones
+        static const size_t MAX_VALUES_PER_KEY = 64;
+        // Values of a key seen before it is judged
+        static const size_t MIN_SAMPLES = 4 * MAX_VALUES_PER_KEY;
+        static const size_t MAX_VALUE_LENGTH = 64;
+        static const size_t MAX_VALUES = 1 << 16;
+
+    private:
+        enum class KeyMode : uint8_t
+        {
+            Sampling,
+            Dictionary,
+            Inline
+        };
+
+        // Sampling state of one key; the distinct values are kept as hashes and
+        // dropped once the key is judged
+        struct KeyState
+        {
+            KeyMode mode = KeyMode::Sampling;
+            size_t seen = 0;
+            unordered_set<size_t> distinct;
+        };
+
+        static string lookupKey(uint32_t keyId, const string &value);
+        uint32_t add(uint32_t keyId, const string &value);
+        // Records one more value of a key that is still sampled
+        void sample(KeyState &state, const string &value);
+
+        mutable shared_mutex valuesMutex;
+        vector<pair<uint32_t, SharedString>> values;
+        // Key id bytes followed by the value
+        unordered_map<string, uint32_t> ids;
+        unordered_map<uint32_t, size_t> valuesPerKey;
+        unordered_map<uint32_t, KeyState> keyStates;
+    };
+}
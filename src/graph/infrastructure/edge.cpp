@@ -37,54 +37,72 @@ Edge Edge::from_json(const string& jsonStr) {
     return e;
 }
 
-void Edge::serialize(ostream& out) const {
-    size_t fromLen = from.size();
-    out.write(reinterpret_cast<const char*>(&fromLen), sizeof(fromLen));
-    out.write(from.data(), fromLen);
-
-    size_t toLen = to.size();
-    out.write(reinterpret_cast<const char*>(&toLen), sizeof(toLen));
-    out.write(to.data(), toLen);
-
-    out.write(reinterpret_cast<const char*>(&weight), sizeof(weight));
-
-    size_t propCount = properties.size();
-    out.write(reinterpret_cast<const char*>(&propCount), sizeof(propCount));
-    for (const auto& [k, v] : properties) {
-        size_t klen = k.size();
-        out.write(reinterpret_cast<const char*>(&klen), sizeof(klen));
-        out.write(k.data(), klen);
-        v.serialize(out);
+void Edge::serialize(BinaryWriter& out, RecordFormat format, RecordDictionaries* dicts) const {
+    // A V5 record is the V4 encoding behind its byte length, so the body is built first
+    if (format >= RecordFormat::V5) {
+        size_t start = out.size();
+        serialize(out, RecordFormat::V4, dicts);
+        BinaryWriter length;
+        writeLength(length, out.size() - start, format);
+        out.insert(start, length.data(), length.size());
+        return;
     }
-}
 
-Edge Edge::deserialize(istream& in) {
-    Edge edge;
+    writeLength(out, from.size(), format);
+    out.write(from.data(), from.size());
+
+    writeLength(out, to.size(), format);
+    out.write(to.data(), to.size());
+
+    out.writeRaw(weight);
+
+    writeLength(out, properties.size(), format);
+    for (const auto& [k, v] : properties)
+        writeProperty(out, k, v, format, dicts);
+}
 
-    size_t fromLen;
-    in.read(reinterpret_cast<char*>(&fromLen), sizeof(fromLen));
-    edge.from.resize(fromLen);
-    in.read(edge.from.data(), fromLen);
+Edge Edge::deserialize(BinaryReader& in, RecordFormat format, const RecordDictionaries* dicts) {
+    EdgeView view = EdgeView::read(in, format);
 
-    size_t toLen;
-    in.read(reinterpret_cast<char*>(&toLen), sizeof(toLen));
-    edge.to.resize(toLen);
-    in.read(edge.to.data(), toLen);
+    Edge edge;
+    edge.from = view.from;
+    edge.to = view.to;
+    edge.weight = view.weight;
+    BinaryReader properties = view.encodedProperties;
+    readProperties(properties, format, dicts, edge.properties);
+    if (!properties)
+        in.fail();
 
-    in.read(reinterpret_cast<char*>(&edge.weight), sizeof(edge.weight));
+    return edge;
+}
 
-    size_t propCount;
-    in.read(reinterpret_cast<char*>(&propCount), sizeof(propCount));
+EdgeView EdgeView::read(BinaryReader& in, RecordFormat format) {
+    EdgeView view;
+    view.format = format;
 
-    for (size_t i = 0; i < propCount; ++i) {
-        size_t klen;
-        in.read(reinterpret_cast<char*>(&klen), sizeof(klen));
-        string key(klen, '\0');
-        in.read(key.data(), klen);
+    size_t end = 0;
+    if (format >= RecordFormat::V5) {
+        size_t length = readLength(in, format);
+        end = in.tell() + length;
+    }
 
-        PropertyValue val = PropertyValue::deserialize(in);
-        edge.properties.emplace(std::move(key), std::move(val));
+    view.from = in.readBytes(readLength(in, format));
+    view.to = in.readBytes(readLength(in, format));
+    view.weight = in.readRaw<double>();
+    size_t propertiesStart = in.tell();
+
+    if (format >= RecordFormat::V5) {
+        in.seek(end);
+    } else {
+        size_t propCount = readLength(in, format);
+        for (size_t i = 0; i < propCount && in; ++i) {
+            skipKey(in, format);
+            skipValue(in, format);
+        }
+        end = in.tell();
     }
 
-    return edge;
+    if (in)
+        view.encodedProperties = in.slice(propertiesStart, end);
+    return view;
 }
@@ -0,0 +1,82 @@
+#include "key_dictionary.hpp"
+#include <mutex>
+#include <stdexcept>
+
+using namespace std;
+
+namespace graphdb
+{
+    uint32_t KeyDictionary::intern(const string &key)
+    {
+        {
+            shared_lock<shared_mutex> lock(keysMutex);
+            auto it = ids.find(key);
+            if (it != ids.end())
+                return it->second;
+        }
+
+        unique_lock<shared_mutex> lock(keysMutex);
+        auto [it, inserted] = ids.emplace(key, static_cast<uint32_t>(keys.size()));
+        if (inserted)
+            keys.push_back(key);
+        return it->second;
+    }
+
+    const string *KeyDictionary::key(uint32_t id) const
+    {
+        shared_lock<shared_mutex> lock(keysMutex);
+        return id < keys.size() ? &keys[id] : nullptr;
+    }
+
+    size_t KeyDictionary::size() const
+    {
+        shared_lock<shared_mutex> lock(keysMutex);
+        return keys.size();
+    }
+
+    vector<string> KeyDictionary::keysFrom(size_t from) const
+    {
+        shared_lock<shared_mutex> lock(keysMutex);
+        if (from >= keys.size())
+            return {};
+        return vector<string>(keys.begin() + from, keys.end());
+    }
+
+    uint32_t writeKey(BinaryWriter &out, const string &key, RecordFormat format, KeyDictionary *keys)
+    {
+        if (format < RecordFormat::V3)
+        {
+            writeLength(out, key.size(), format);
+            out.write(key.data(), key.size());
+            return NO_KEY_ID;
+        }
+
+        if (!keys)
+            throw runtime_error("Record format V3 needs a key dictionary");
+        uint32_t id = keys->intern(key);
+        writeLength(out, id, format);
+        return id;
+    }
+
+    string_view readKey(BinaryReader &in, RecordFormat format, const KeyDictionary *keys)
+    {
+        if (format < RecordFormat::V3)
+            return in.readBytes(readLength(in, format));
+
+        size_t id = readLength(in, format);
+        const string *key = keys && id <= UINT32_MAX ? keys->key(static_cast<uint32_t>(id)) : nullptr;
+        if (!key)
+        {
+            in.fail();
+            return {};
+        }
+        return *key;
+    }
+
+    void skipKey(BinaryReader &in, RecordFormat format)
+    {
+        size_t value = readLength(in, format);
+        if (format < RecordFormat::V3)
+            in.skip(value);
+    }
+}
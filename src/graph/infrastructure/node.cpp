@@ -32,42 +32,65 @@ Node Node::from_json(const string& jsonStr) {
     return node;
 }
 
-void Node::serialize(ostream& out) const {
-    size_t idLen = id.size();
-    out.write(reinterpret_cast<const char*>(&idLen), sizeof(idLen));
-    out.write(id.data(), idLen);
-
-    size_t propCount = properties.size();
-    out.write(reinterpret_cast<const char*>(&propCount), sizeof(propCount));
-
-    for (const auto& [k, v] : properties) {
-        size_t klen = k.size();
-        out.write(reinterpret_cast<const char*>(&klen), sizeof(klen));
-        out.write(k.data(), klen);
-        v.serialize(out);
+void Node::serialize(BinaryWriter& out, RecordFormat format, RecordDictionaries* dicts) const {
+    // A V5 record is the V4 encoding behind its byte length, so the body is built first
+    if (format >= RecordFormat::V5) {
+        size_t start = out.size();
+        serialize(out, RecordFormat::V4, dicts);
+        BinaryWriter length;
+        writeLength(length, out.size() - start, format);
+        out.insert(start, length.data(), length.size());
+        return;
     }
+
+    writeLength(out, id.size(), format);
+    out.write(id.data(), id.size());
+
+    writeLength(out, properties.size(), format);
+
+    for (const auto& [k, v] : properties)
+        writeProperty(out, k, v, format, dicts);
 }
 
-Node Node::deserialize(istream& in) {
+Node Node::deserialize(BinaryReader& in, RecordFormat format, const RecordDictionaries* dicts) {
+    NodeView view = NodeView::read(in, format);
+
     Node node;
+    node.id = view.id;
+    BinaryReader properties = view.encodedProperties;
+    readProperties(properties, format, dicts, node.properties);
+    if (!properties)
+        in.fail();
 
-    size_t idLen;
-    in.read(reinterpret_cast<char*>(&idLen), sizeof(idLen));
-    node.id.resize(idLen);
-    in.read(node.id.data(), idLen);
+    return node;
+}
 
-    size_t propCount;
-    in.read(reinterpret_cast<char*>(&propCount), sizeof(propCount));
+NodeView NodeView::read(BinaryReader& in, RecordFormat format) {
+    NodeView view;
+    view.format = format;
 
-    for (size_t i = 0; i < propCount; ++i) {
-        size_t klen;
-        in.read(reinterpret_cast<char*>(&klen), sizeof(klen));
-        string key(klen, '\0');
-        in.read(key.data(), klen);
+    // In-place upserts may leave padding behind a V5 body, so the prefix decides where the record ends
+    size_t end = 0;
+    if (format >= RecordFormat::V5) {
+        size_t length = readLength(in, format);
+        end = in.tell() + length;
+    }
 
-        PropertyValue val = PropertyValue::deserialize(in);
-        node.properties.emplace(move(key), move(val));
+    view.id = in.readBytes(readLength(in, format));
+    size_t propertiesStart = in.tell();
+
+    if (format >= RecordFormat::V5) {
+        in.seek(end);
+    } else {
+        size_t propCount = readLength(in, format);
+        for (size_t i = 0; i < propCount && in; ++i) {
+            skipKey(in, format);
+            skipValue(in, format);
+        }
+        end = in.tell();
     }
 
-    return node;
+    if (in)
+        view.encodedProperties = in.slice(propertiesStart, end);
+    return view;
 }
@@ -8,6 +8,15 @@ using json = nlohmann::json;
 
 namespace graphdb
 {
+    const string *PropertyValue::asString() const
+    {
+        if (auto s = get_if<string>(&value))
+            return s;
+        if (auto s = get_if<SharedString>(&value))
+            return s->get();
+        return nullptr;
+    }
+
     size_t PropertyValue::estimateSize() const
     {
         return visit([](auto &&arg) -> size_t
@@ -17,6 +26,8 @@ namespace graphdb
             return 1 + sizeof(arg);
         } else if constexpr (is_same_v<T,string>) {
             return 1 + sizeof(size_t) + arg.size();
+        } else if constexpr (is_same_v<T,SharedString>) {
+            return 1 + sizeof(size_t) + arg->size();
         } else if constexpr (is_same_v<T,shared_ptr<PropertyMap>>) {
             size_t total = 1 + sizeof(size_t);
             for (const auto& [k,v] : *arg) {
@@ -33,7 +44,7 @@ namespace graphdb
         json j;
         if (holds_alternative<int>(value)) j = get<int>(value);
         else if (holds_alternative<double>(value)) j = get<double>(value);
-        else if (holds_alternative<string>(value)) j = get<string>(value);
+        else if (auto s = asString()) j = *s;
         else if (holds_alternative<bool>(value)) j = get<bool>(value);
         else if (holds_alternative<shared_ptr<PropertyMap>>(value)) {
             j = json::object();
@@ -58,86 +69,146 @@ namespace graphdb
         throw runtime_error("Unsupported JSON type for PropertyValue");
     }
 
-    void PropertyValue::serialize(ostream &out) const
+    static void writeValue(const PropertyValue &value, BinaryWriter &out, RecordFormat format, RecordDictionaries *dicts, uint32_t keyId)
     {
-        visit([&out](auto &&arg)
+        if (const string *s = value.asString())
+        {
+            // Only entries interned (and persisted) by internAll before the write are used
+            optional<uint32_t> id;
+            if (format >= RecordFormat::V4 && dicts && keyId != NO_KEY_ID)
+                id = dicts->values.find(keyId, *s);
+
+            if (id)
+            {
+                out.put(5);
+                writeLength(out, *id, format);
+            }
+            else
+            {
+                out.put(3);
+                writeLength(out, s->size(), format);
+                out.write(s->data(), s->size());
+            }
+            return;
+        }
+
+        visit([&out, format, dicts](auto &&arg)
                    {
             using T = decay_t<decltype(arg)>;
             if constexpr (is_same_v<T,int>) {
-                char type = 0; out.write(&type,1); out.write(reinterpret_cast<const char*>(&arg), sizeof(arg));
+                out.put(0); out.writeRaw(arg);
             } else if constexpr (is_same_v<T,double>) {
-                char type = 1; out.write(&type,1); out.write(reinterpret_cast<const char*>(&arg), sizeof(arg));
+                out.put(1); out.writeRaw(arg);
             } else if constexpr (is_same_v<T,bool>) {
-                char type = 2; out.write(&type,1); out.write(reinterpret_cast<const char*>(&arg), sizeof(arg));
-            } else if constexpr (is_same_v<T,string>) {
-                char type = 3; out.write(&type,1);
-                size_t len = arg.size();
-                out.write(reinterpret_cast<const char*>(&len), sizeof(len));
-                out.write(arg.c_str(), len);
+                out.put(2); out.writeRaw(arg);
             } else if constexpr (is_same_v<T,shared_ptr<PropertyMap>>) {
-                char type = 4; out.write(&type,1);
-                size_t count = arg->size();
-                out.write(reinterpret_cast<const char*>(&count), sizeof(count));
-                for (const auto& [k,v] : *arg) {
-                    size_t klen = k.size();
-                    out.write(reinterpret_cast<const char*>(&klen), sizeof(klen));
-                    out.write(k.c_str(), klen);
-                    v.serialize(out);
-                }
-            } }, value);
+                out.put(4);
+                writeLength(out, arg->size(), format);
+                for (const auto& [k,v] : *arg)
+                    writeProperty(out, k, v, format, dicts);
+            } }, value.value);
+    }
+
+    // Standalone values have no key, so their strings always stay inline
+    void PropertyValue::serialize(BinaryWriter &out, RecordFormat format, RecordDictionaries *dicts) const
+    {
+        writeValue(*this, out, format, dicts, NO_KEY_ID);
+    }
+
+    void writeProperty(BinaryWriter &out, const string &key, const PropertyValue &value, RecordFormat format, RecordDictionaries *dicts)
+    {
+        uint32_t keyId = writeKey(out, key, format, dicts ? &dicts->keys : nullptr);
+        writeValue(value, out, format, dicts, keyId);
+    }
+
+    void readProperties(BinaryReader &in, RecordFormat format, const RecordDictionaries *dicts, PropertyMap &properties)
+    {
+        size_t count = readLength(in, format);
+        for (size_t i = 0; i < count && in; ++i)
+        {
+            // The view points into the record or the key dictionary; the map builds its only copy
+            string_view key = readKey(in, format, dicts ? &dicts->keys : nullptr);
+            PropertyValue value = PropertyValue::deserialize(in, format, dicts);
+            properties.emplace(key, move(value));
+        }
     }
 
-    PropertyValue PropertyValue::deserialize(istream &in)
+    void skipValue(BinaryReader &in, RecordFormat format)
     {
-        char type;
-        in.read(&type, 1);
+        char type = in.readRaw<char>();
+        if (!in)
+            return;
 
         switch (type)
         {
         case 0:
-        {
-            int val;
-            in.read(reinterpret_cast<char *>(&val), sizeof(val));
-            return PropertyValue(val);
-        }
+            in.skip(sizeof(int));
+            break;
         case 1:
-        {
-            double val;
-            in.read(reinterpret_cast<char *>(&val), sizeof(val));
-            return PropertyValue(val);
-        }
+            in.skip(sizeof(double));
+            break;
         case 2:
-        {
-            bool val;
-            in.read(reinterpret_cast<char *>(&val), sizeof(val));
-            return PropertyValue(val);
-        }
+            in.skip(sizeof(bool));
+            break;
         case 3:
+            in.skip(readLength(in, format));
+            break;
+        case 4:
         {
-            size_t len;
-            in.read(reinterpret_cast<char *>(&len), sizeof(len));
-            string s(len, '\0');
-            in.read(&s[0], len);
-            return PropertyValue(s);
+            size_t count = readLength(in, format);
+            for (size_t i = 0; i < count && in; ++i)
+            {
+                skipKey(in, format);
+                skipValue(in, format);
+            }
+            break;
+        }
+        case 5:
+            readLength(in, format);
+            break;
+        default:
+            // A damaged record fails the reader like a short one, so callers see one kind of error
+            in.fail();
+            break;
         }
+    }
+
+    PropertyValue PropertyValue::deserialize(BinaryReader &in, RecordFormat format, const RecordDictionaries *dicts)
+    {
+        char type = in.readRaw<char>();
+        if (!in)
+            return PropertyValue();
+
+        switch (type)
+        {
+        case 0:
+            return PropertyValue(in.readRaw<int>());
+        case 1:
+            return PropertyValue(in.readRaw<double>());
+        case 2:
+            return PropertyValue(in.readRaw<bool>());
+        case 3:
+            return PropertyValue(string(in.readBytes(readLength(in, format))));
         case 4:
         {
-            size_t count;
-            in.read(reinterpret_cast<char *>(&count), sizeof(count));
             PropertyMap map;
-            for (size_t i = 0; i < count; ++i)
+            readProperties(in, format, dicts, map);
+            return PropertyValue(map);
+        }
+        case 5:
+        {
+            size_t id = readLength(in, format);
+            SharedString s = dicts && id <= UINT32_MAX ? dicts->values.value(static_cast<uint32_t>(id)) : nullptr;
+            if (!s)
             {
-                size_t klen;
-                in.read(reinterpret_cast<char *>(&klen), sizeof(klen));
-                string k(klen, '\0');
-                in.read(&k[0], klen);
-                PropertyValue v = PropertyValue::deserialize(in);
-                map[k] = v;
+                in.fail();
+                return PropertyValue();
             }
-            return PropertyValue(map);
+            return PropertyValue(move(s));
         }
         default:
-            throw runtime_error("Unknown PropertyValue type");
+            in.fail();
+            return PropertyValue();
         }
     }
-}
\ No newline at end of file
+}
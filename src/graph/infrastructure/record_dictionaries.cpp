@@ -0,0 +1,19 @@
+#include "record_dictionaries.hpp"
+#include "property.hpp"
+
+using namespace std;
+
+namespace graphdb
+{
+    void RecordDictionaries::internAll(const PropertyMap &properties)
+    {
+        for (const auto &[k, v] : properties)
+        {
+            uint32_t keyId = keys.intern(k);
+            if (const string *s = v.asString())
+                values.encode(keyId, *s);
+            else if (auto map = get_if<shared_ptr<PropertyMap>>(&v.value))
+                internAll(**map);
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#include "record_format.hpp"
+
+using namespace std;
+
+namespace graphdb
+{
+    void writeLength(BinaryWriter &out, size_t value, RecordFormat format)
+    {
+        if (format == RecordFormat::V1)
+        {
+            out.writeRaw(value);
+            return;
+        }
+
+        char buf[10];
+        size_t n = 0;
+        do
+        {
+            uint8_t byte = value & 0x7F;
+            value >>= 7;
+            buf[n++] = static_cast<char>(value ? byte | 0x80 : byte);
+        } while (value);
+        out.write(buf, n);
+    }
+
+    size_t readLength(BinaryReader &in, RecordFormat format)
+    {
+        if (format == RecordFormat::V1)
+            return in.readRaw<size_t>();
+
+        size_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            uint8_t byte = in.readRaw<uint8_t>();
+            if (!in)
+                return 0;
+
+            value |= static_cast<size_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+
+        in.fail();
+        return 0;
+    }
+}
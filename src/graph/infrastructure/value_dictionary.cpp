@@ -0,0 +1,109 @@
+#include "value_dictionary.hpp"
+#include <functional>
+#include <mutex>
+
+using namespace std;
+
+namespace graphdb
+{
+    string ValueDictionary::lookupKey(uint32_t keyId, const string &value)
+    {
+        string k(reinterpret_cast<const char *>(&keyId), sizeof(keyId));
+        k.append(value);
+        return k;
+    }
+
+    optional<uint32_t> ValueDictionary::encode(uint32_t keyId, const string &value)
+    {
+        string k = lookupKey(keyId, value);
+        {
+            shared_lock<shared_mutex> lock(valuesMutex);
+            auto it = ids.find(k);
+            if (it != ids.end())
+                return it->second;
+            auto state = keyStates.find(keyId);
+            if (state != keyStates.end() && state->second.mode == KeyMode::Inline)
+                return nullopt;
+        }
+
+        unique_lock<shared_mutex> lock(valuesMutex);
+        auto it = ids.find(k);
+        if (it != ids.end())
+            return it->second;
+
+        KeyState &state = keyStates[keyId];
+        if (state.mode == KeyMode::Sampling)
+            sample(state, value);
+        if (state.mode != KeyMode::Dictionary)
+            return nullopt;
+
+        if (value.size() > MAX_VALUE_LENGTH || valuesPerKey[keyId] >= MAX_VALUES_PER_KEY || values.size() >= MAX_VALUES)
+            return nullopt;
+        return add(keyId, value);
+    }
+
+    void ValueDictionary::sample(KeyState &state, const string &value)
+    {
+        // Long values count as distinct values like any other, which rules out free text quickly
+        state.distinct.insert(hash<string>{}(value));
+        ++state.seen;
+
+        if (state.distinct.size() > MAX_VALUES_PER_KEY)
+            state.mode = KeyMode::Inline;
+        else if (state.seen >= MIN_SAMPLES)
+            state.mode = KeyMode::Dictionary;
+        else
+            return;
+        unordered_set<size_t>().swap(state.distinct);
+    }
+
+    optional<uint32_t> ValueDictionary::find(uint32_t keyId, const string &value) const
+    {
+        shared_lock<shared_mutex> lock(valuesMutex);
+        auto it = ids.find(lookupKey(keyId, value));
+        if (it == ids.end())
+            return nullopt;
+        return it->second;
+    }
+
+    void ValueDictionary::restore(uint32_t keyId, const string &value)
+    {
+        unique_lock<shared_mutex> lock(valuesMutex);
+        // A key with persisted entries was judged low-cardinality in an earlier session
+        KeyState &state = keyStates[keyId];
+        state.mode = KeyMode::Dictionary;
+        unordered_set<size_t>().swap(state.distinct);
+        if (!ids.count(lookupKey(keyId, value)))
+            add(keyId, value);
+    }
+
+    uint32_t ValueDictionary::add(uint32_t keyId, const string &value)
+    {
+        uint32_t id = static_cast<uint32_t>(values.size());
+        values.emplace_back(keyId, make_shared<const string>(value));
+        ids.emplace(lookupKey(keyId, value), id);
+        ++valuesPerKey[keyId];
+        return id;
+    }
+
+    SharedString ValueDictionary::value(uint32_t id) const
+    {
+        shared_lock<shared_mutex> lock(valuesMutex);
+        return id < values.size() ? values[id].second : nullptr;
+    }
+
+    size_t ValueDictionary::size() const
+    {
+        shared_lock<shared_mutex> lock(valuesMutex);
+        return values.size();
+    }
+
+    vector<pair<uint32_t, string>> ValueDictionary::entriesFrom(size_t from) const
+    {
+        shared_lock<shared_mutex> lock(valuesMutex);
+        vector<pair<uint32_t, string>> entries;
+        for (size_t i = from; i < values.size(); ++i)
+            entries.emplace_back(values[i].first, *values[i].second);
+        return entries;
+    }
+}
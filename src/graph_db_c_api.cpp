@@ -2,6 +2,7 @@
 #include "storage.hpp"
 #include "node.hpp"
 #include "edge.hpp"
+#include "csr_snapshot.hpp"
 
 #include <string>
 #include <memory>
@@ -79,9 +80,22 @@ Box* graphdb_init(const char* boxName)
         return nullptr;
 
     auto* box = new GraphDB();
-    box->storage = make_unique<Storage>(string(boxName));
-    box->storage->buildNodeIndex();
-    box->storage->buildEdgeIndex();
+    try
+    {
+        box->storage = make_unique<Storage>(string(boxName));
+        box->storage->loadNodeIndex();
+        box->storage->loadEdgeIndex();
+        // Writes acknowledged before a crash live only in the WAL until replayed
+        box->storage->recoverWriteAheadLog();
+        box->storage->startBackgroundCompaction();
+    }
+    catch (const std::exception& e)
+    {
+        printf("graphdb_init: CRITICAL ERROR - Exception caught: %s\n", e.what());
+        fflush(stdout);
+        delete box;
+        return nullptr;
+    }
 
     return box;
 }
@@ -99,12 +113,8 @@ void graphdb_save_nodes(Box* box, const char* jsonData)
         vector<Node> nodes = parse_nodes_from_json(jsonData);
         printf("graphdb_save_nodes: Successfully parsed %zu nodes.\n", nodes.size());
         fflush(stdout);
-        box->storage->saveNodeChunk(nodes);
-        printf("graphdb_save_nodes: saveNodeChunk finished successfully.\n");
-        fflush(stdout);
-        // Rebuild index after saving nodes so they can be loaded
-        box->storage->buildNodeIndex();
-        printf("graphdb_save_nodes: Node index rebuilt.\n");
+        box->storage->saveNodes(nodes);
+        printf("graphdb_save_nodes: saveNodes finished successfully.\n");
         fflush(stdout);
     }
     catch (const std::exception& e)
@@ -132,12 +142,8 @@ void graphdb_save_edges(Box* box, const char* jsonData)
         vector<Edge> edges = parse_edges_from_json(jsonData);
         printf("graphdb_save_edges: Successfully parsed %zu edges.\n", edges.size());
         fflush(stdout);
-        box->storage->saveEdgeChunk(edges);
-        printf("graphdb_save_edges: saveEdgeChunk finished successfully.\n");
-        fflush(stdout);
-        // Rebuild index after saving edges so they can be loaded
-        box->storage->buildEdgeIndex();
-        printf("graphdb_save_edges: Edge index rebuilt.\n");
+        box->storage->saveEdges(edges);
+        printf("graphdb_save_edges: saveEdges finished successfully.\n");
         fflush(stdout);
     }
     catch (const std::exception& e)
@@ -162,8 +168,7 @@ void graphdb_delete_node(Box* box, const char* nodeId)
 
     try
     {
-        box->storage->deleteNode(string(nodeId));
-        box->storage->buildNodeIndex();
+        box->storage->removeNode(string(nodeId));
         printf("graphdb_delete_node: Successfully deleted node: %s\n", nodeId);
         fflush(stdout);
     }
@@ -187,6 +192,10 @@ const char* graphdb_load_node(Box* box, const char* nodeId)
         return nullptr;
     }
 
+    // Misses are answered by the existence filter, without a throw or a log line
+    if (!box->storage->containsNode(nodeId))
+        return nullptr;
+
     try
     {
         printf("graphdb_load_node: Attempting to load node with ID: %s\n", nodeId);
@@ -213,6 +222,14 @@ const char* graphdb_load_node(Box* box, const char* nodeId)
     }
 }
 
+int graphdb_contains_node(Box* box, const char* nodeId)
+{
+    if (!box || !nodeId)
+        return 0;
+
+    return box->storage->containsNode(nodeId) ? 1 : 0;
+}
+
 const char* graphdb_load_edges(Box* box, const char* nodeId)
 {
     if (!box || !nodeId)
@@ -236,6 +253,18 @@ const char* graphdb_load_edges(Box* box, const char* nodeId)
     }
 }
 
+void graphdb_edge_cache_stats(Box* box, unsigned long long* hits, unsigned long long* misses)
+{
+    if (!box)
+        return;
+
+    EdgeListCache::Stats stats = box->storage->edgeCacheStats();
+    if (hits)
+        *hits = stats.hits;
+    if (misses)
+        *misses = stats.misses;
+}
+
 void graphdb_build_node_index(Box* box)
 {
     if (box)
@@ -248,6 +277,80 @@ void graphdb_build_edge_index(Box* box)
         box->storage->buildEdgeIndex();
 }
 
+void graphdb_compact(Box* box)
+{
+    if (!box)
+        return;
+
+    try
+    {
+        box->storage->compactNodeChunks();
+        box->storage->reorganizeEdgeChunks();
+        box->storage->writeNodeFooters();
+        box->storage->compressSealedChunks();
+    }
+    catch (const std::exception& e)
+    {
+        printf("graphdb_compact: ERROR - Exception caught: %s\n", e.what());
+        fflush(stdout);
+    }
+}
+
+void graphdb_set_chunk_compression(Box* box, int enabled)
+{
+    if (box)
+        box->storage->setChunkCompression(enabled != 0);
+}
+
+long long graphdb_seal_snapshot(Box* box)
+{
+    if (!box)
+        return -1;
+
+    try
+    {
+        return box->storage->sealSnapshot();
+    }
+    catch (const std::exception& e)
+    {
+        printf("graphdb_seal_snapshot: ERROR - Exception caught: %s\n", e.what());
+        fflush(stdout);
+        return -1;
+    }
+}
+
+const char* graphdb_load_snapshot_edges(Box* box, const char* nodeId)
+{
+    if (!box || !nodeId)
+        return nullptr;
+
+    try
+    {
+        shared_ptr<const CsrSnapshot> snapshot = box->storage->snapshot();
+        if (!snapshot)
+            return nullptr;
+
+        int64_t node = snapshot->find(nodeId);
+        if (node < 0)
+            return nullptr;
+
+        span<const uint32_t> targets = snapshot->targets(static_cast<uint32_t>(node));
+        span<const double> weights = snapshot->weights(static_cast<uint32_t>(node));
+        json j = json::array();
+        for (size_t i = 0; i < targets.size(); ++i)
+            j.push_back({{"from", nodeId}, {"to", snapshot->id(targets[i])}, {"weight", weights[i]}});
+
+        string jsonStr = j.dump();
+        char* result = (char*)malloc(jsonStr.size() + 1);
+        strcpy(result, jsonStr.c_str());
+        return result;
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
 void graphdb_free_string(const char* str)
 {
     free((void*)str);
@@ -21,13 +21,33 @@ void graphdb_delete_node(Box* box, const char* nodeId);
 // Load a single node by ID (returns malloc'ed string, free with graphdb_free_string)
 const char* graphdb_load_node(Box* box, const char* nodeId);
 
+// Check whether a node exists without loading it (1 = exists, 0 = not found)
+int graphdb_contains_node(Box* box, const char* nodeId);
+
 // Load edges for a node (returns malloc'ed JSON string)
 const char* graphdb_load_edges(Box* box, const char* nodeId);
 
+// Hit and miss counts of the cache behind graphdb_load_edges since the box was opened
+void graphdb_edge_cache_stats(Box* box, unsigned long long* hits, unsigned long long* misses);
+
 // Build indexes manually (optional, usually called internally)
 void graphdb_build_node_index(Box* box);
 void graphdb_build_edge_index(Box* box);
 
+// Reclaim space left by deleted nodes right away (normally done on a background thread)
+void graphdb_compact(Box* box);
+
+// Store sealed chunks block-compressed from now on (0 = off, the default)
+void graphdb_set_chunk_compression(Box* box, int enabled);
+
+// Export all edges into the box's CSR snapshot file (graph.csr) for whole-graph scans.
+// Returns the number of edges written, or -1 on failure.
+long long graphdb_seal_snapshot(Box* box);
+
+// Load a node's edges as of the last sealed snapshot, read from the mapped file
+// (returns malloc'ed JSON string, NULL when there is no snapshot or the node is not in it)
+const char* graphdb_load_snapshot_edges(Box* box, const char* nodeId);
+
 // Estimate node chunk size from JSON (returns size in bytes)
 size_t graphdb_estimate_nodes_size(Box* box, const char* jsonData);
 
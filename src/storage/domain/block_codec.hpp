@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+
+namespace graphdb
+{
+    // Small LZ4-style block codec (greedy hash matcher, LZ4 block sequence format).
+    // Self-contained so compressed chunks need no system library on any platform.
+    namespace BlockCodec
+    {
+        // Worst-case compressed size of n input bytes
+        size_t compressBound(size_t n);
+
+        // Returns the compressed size; dst must hold compressBound(n) bytes
+        size_t compress(const char *src, size_t n, char *dst);
+
+        // Decodes exactly outSize bytes; false on malformed input
+        bool decompress(const char *src, size_t n, char *dst, size_t outSize);
+    }
+}
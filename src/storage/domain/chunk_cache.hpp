@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include "mapped_file.hpp"
+
+using namespace std;
+namespace fs = filesystem;
+
+namespace graphdb
+{
+    // Bounded LRU of open chunk files keyed by chunk number. Each entry owns the
+    // descriptor and its mapping, so a hit costs neither an open nor an mmap.
+    // Callers keep the returned pointer alive for as long as they read from it,
+    // which makes eviction and invalidation safe while a read is in progress.
+    class ChunkCache
+    {
+    public:
+        explicit ChunkCache(size_t capacity);
+
+        shared_ptr<const MappedFile> acquire(int chunk, const fs::path &file);
+        void invalidate(int chunk);
+        void clear();
+
+    private:
+        using Entry = pair<int, shared_ptr<const MappedFile>>;
+
+        size_t capacity;
+        list<Entry> lru;
+        unordered_map<int, list<Entry>::iterator> entries;
+        mutex cacheMutex;
+    };
+}
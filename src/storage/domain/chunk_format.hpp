@@ -0,0 +1,116 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <vector>
+#include "mapped_file.hpp"
+#include "node.hpp"
+#include "edge.hpp"
+#include "record_format.hpp"
+
+using namespace std;
+namespace fs = filesystem;
+
+namespace graphdb
+{
+    // Set on sealed chunks (v2 and later) that were rewritten as independently compressed blocks.
+    // Record offsets keep addressing the uncompressed bytes, so the indexes and
+    // tombstones of a chunk stay valid when it gets compressed.
+    const uint16_t CHUNK_FLAG_COMPRESSED = 0x1;
+    // Uncompressed bytes per block; a point read decodes one or two of them
+    const uint32_t COMPRESSED_BLOCK_SIZE = 16 * 1024;
+
+    // First bytes of every chunk file. v1 chunks start with a bare native size_t
+    // record count; later chunks start with "GDBC", the record format version and
+    // flags, then the count. A v1 count never has "GDBC" in its low bytes together
+    // with a non-zero high word, so the two cannot be confused.
+    struct ChunkHeader
+    {
+        RecordFormat format = CURRENT_RECORD_FORMAT;
+        uint16_t flags = 0;
+        uint64_t count = 0;
+
+        // Bytes taken by the header, i.e. where the first record starts
+        size_t size() const { return format == RecordFormat::V1 ? sizeof(uint64_t) : 16; }
+        // Where the record count lives, for patching it after an append
+        size_t countOffset() const { return format == RecordFormat::V1 ? 0 : 8; }
+
+        bool compressed() const { return (flags & CHUNK_FLAG_COMPRESSED) != 0; }
+
+        // Returns false on a short read or an unknown format version
+        bool read(istream &in);
+        void write(ostream &out) const;
+    };
+
+    // Writes a compressed copy of an uncompressed v2 or later chunk to target:
+    // [header][logical size][block size][block count][block offsets][blocks].
+    // A block that does not shrink is stored as is. Returns false on a write error.
+    bool writeCompressedChunk(const MappedFile &source, const fs::path &target);
+
+    // Size of a chunk's records as addressed by offsets, i.e. before compression
+    uint64_t logicalChunkSize(const fs::path &file);
+
+    // Record decoder over a mapped chunk that follows the chunk's own format.
+    // Uncompressed chunks are decoded straight from the mapping; compressed ones
+    // from a window of decoded blocks around the read position.
+    class ChunkReader
+    {
+    public:
+        // dicts resolves the key and value ids of V3 and later records
+        ChunkReader(const MappedFile &mapping, const RecordDictionaries *dicts);
+
+        ChunkReader(const ChunkReader &) = delete;
+        ChunkReader &operator=(const ChunkReader &) = delete;
+
+        // False when the header is unreadable; nothing should be decoded then
+        bool valid() const { return headerValid; }
+        const ChunkHeader &header() const { return chunkHeader; }
+        // False once a read ran past the chunk or met a malformed record; seek() clears it
+        bool good() const { return !failed; }
+
+        void seek(size_t offset);
+        size_t tell() const { return position; }
+
+        // Hints the kernel to read the bytes behind the logical range [offset, offset + count)
+        void prefetch(size_t offset, size_t count) const;
+
+        Node readNode();
+        Edge readEdge();
+        // Views into the mapping, or into the decoded window of a compressed chunk;
+        // the latter only last until the next read
+        NodeView readNodeView();
+        EdgeView readEdgeView();
+        // A bare length in the chunk's encoding, e.g. the prefix of a V5 record
+        size_t readLength();
+
+    private:
+        bool openBlocks();
+        // Reader positioned at `position` over at least minBytes of logical bytes,
+        // fewer only at the end of the chunk
+        BinaryReader bytesAt(size_t minBytes);
+        bool decodeWindow(size_t first, size_t last);
+        // Runs decode at the read position and advances past what it consumed. A record
+        // running off the decoded window is retried once over the rest of the chunk.
+        template <typename Decode>
+        auto decodeAt(Decode &&decode);
+
+        const MappedFile &mapping;
+        const RecordDictionaries *dicts;
+        ChunkHeader chunkHeader;
+        bool headerValid;
+        size_t position = 0;
+        bool failed = false;
+
+        // Block offsets inside the mapping; null for uncompressed chunks
+        const uint64_t *blockOffsets = nullptr;
+        uint64_t blockCount = 0;
+        uint64_t blockSize = 0;
+        uint64_t logicalSize = 0;
+        // Decoded bytes of the blocks covering the logical range [windowStart, windowStart + window.size())
+        vector<char> window;
+        size_t windowStart = 0;
+    };
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "mapped_file.hpp"
+
+using namespace std;
+namespace fs = filesystem;
+
+namespace graphdb
+{
+    // Point-in-time adjacency of a whole box in compressed sparse row form.
+    // Nodes get dense ids in sorted id order; the out-edges of node n are
+    // targets[offsets[n] .. offsets[n + 1]) with the matching weights.
+    // Layout: header, id offsets, edge offsets, targets (padded to 8 bytes),
+    // weights, id bytes - every section fixed-width so the file is used as mapped.
+    class CsrSnapshot
+    {
+    public:
+        // Maps and validates the file. Returns false when it is missing or malformed.
+        bool open(const fs::path &file);
+
+        uint64_t nodeCount() const { return nodes; }
+        uint64_t edgeCount() const { return edges; }
+
+        string_view id(uint32_t node) const;
+        // Dense id of a node, or -1 when the snapshot does not contain it
+        int64_t find(string_view id) const;
+
+        span<const uint32_t> targets(uint32_t node) const;
+        span<const double> weights(uint32_t node) const;
+
+        // ids must be sorted and unique; offsets has ids.size() + 1 entries
+        static bool write(const fs::path &file, const vector<string> &ids, const vector<uint64_t> &offsets,
+                          const vector<uint32_t> &targets, const vector<double> &weights);
+
+    private:
+        MappedFile mapping;
+        uint64_t nodes = 0;
+        uint64_t edges = 0;
+        const uint64_t *idOffsets = nullptr;
+        const uint64_t *edgeOffsets = nullptr;
+        const uint32_t *targetArray = nullptr;
+        const double *weightArray = nullptr;
+        const char *ids = nullptr;
+    };
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+namespace graphdb
+{
+    // Approximate set of keys, each given by a well-mixed 64-bit hash: 16-bit
+    // fingerprints in buckets of four, each key living in one of two buckets
+    // (partial-key cuckoo hashing). Answers "definitely absent" or "probably
+    // present" (about 1 in 8000 false positives) in a couple of memory
+    // accesses, and unlike a bloom filter it supports removal. Keys must not
+    // be inserted twice. Not thread-safe.
+    class CuckooFilter
+    {
+    public:
+        // Empties the filter and sizes it for about capacity keys
+        void reset(size_t capacity);
+
+        // False when the filter is full; the key is then not stored and the
+        // filter has to be reset larger and refilled
+        bool insert(uint64_t keyHash);
+        bool mayContain(uint64_t keyHash) const;
+        // Removes one earlier insert of the key
+        void erase(uint64_t keyHash);
+
+    private:
+        static const size_t SLOTS_PER_BUCKET = 4;
+        static const int MAX_KICKS = 500;
+
+        struct Probe
+        {
+            uint16_t fingerprint;
+            size_t first;
+            size_t second;
+        };
+
+        Probe probe(uint64_t keyHash) const;
+        size_t alternate(size_t bucket, uint16_t fingerprint) const;
+        bool bucketHas(size_t bucket, uint16_t fingerprint) const;
+        bool place(size_t bucket, uint16_t fingerprint);
+
+        vector<uint16_t> slots;
+        size_t bucketMask = 0;
+        // A fingerprint displaced by an insert that ran out of kicks; a set
+        // victim means the filter is full
+        uint16_t victim = 0;
+        size_t victimBucket = 0;
+    };
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+namespace fs = filesystem;
+
+namespace graphdb
+{
+    // Append-only file of dictionary entries in id order: a magic + version header
+    // followed by [u32 length][bytes] per entry. Backs the box's key dictionary
+    // ("keys.dict") and value dictionary ("values.dict"); entries are synced
+    // before any chunk record refers to them.
+    struct DictionaryFile
+    {
+        // Calls add(entry) for every stored entry in order and cuts off a torn
+        // trailing entry. A missing file is an empty dictionary; false means the
+        // file is unusable (wrong magic or version).
+        static bool load(const fs::path &file, const char (&magic)[4], const function<void(const string &)> &add);
+
+        // Appends entries and syncs the file
+        static bool append(const fs::path &file, const char (&magic)[4], const vector<string> &entries);
+    };
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "edge.hpp"
+
+using namespace std;
+
+namespace graphdb
+{
+    // Byte-budgeted LRU of decoded on-disk edge lists keyed by source id, so hot
+    // sources skip the run reads and record decoding of loadEdgesFromNode.
+    // Edges appended for a cached source are added to its list in place instead
+    // of dropping it. Not thread-safe; Storage uses it under storageMutex.
+    class EdgeListCache
+    {
+    public:
+        struct Stats
+        {
+            uint64_t hits;
+            uint64_t misses;
+            size_t entries;
+            size_t bytes;
+        };
+
+        explicit EdgeListCache(size_t budgetBytes);
+
+        // Counts a hit or a miss; the list stays valid until the next call that changes the cache
+        const vector<Edge> *get(const string &from);
+        void put(const string &from, vector<Edge> edges);
+        // Extends the cached list of the source, if there is one
+        void append(const string &from, const Edge &edge);
+        void invalidate(const string &from);
+        void clear();
+
+        Stats stats() const;
+
+    private:
+        struct Entry
+        {
+            string from;
+            vector<Edge> edges;
+            size_t bytes;
+        };
+
+        static size_t weigh(const Edge &edge);
+        void evict();
+
+        size_t budget;
+        size_t bytes = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        // Front is most recently used
+        list<Entry> lru;
+        unordered_map<string, list<Entry>::iterator> entries;
+    };
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "mapped_file.hpp"
+
+using namespace std;
+namespace fs = filesystem;
+
+namespace graphdb
+{
+    // Identifies the on-disk state of a chunk file and its tombstones. A chunk whose
+    // stamp differs from the one recorded in an index file has to be rescanned.
+    struct ChunkStamp
+    {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        uint64_t tombstoneSize = 0;
+
+        bool operator==(const ChunkStamp &other) const = default;
+
+        static ChunkStamp of(const fs::path &file);
+    };
+
+    // Hash of a node id (NodeIndex::hashId) and where its record lives
+    struct NodeIndexEntry
+    {
+        uint64_t hash;
+        uint32_t chunk;
+        uint32_t offset;
+    };
+
+    // Persistent copy of Storage::nodeIndex, stored next to the nodes folder.
+    // Layout: header, chunk stamp table, then the fixed-width hash -> (chunk, offset) entries.
+    struct NodeIndexFile
+    {
+        unordered_map<uint32_t, ChunkStamp> chunks;
+        vector<NodeIndexEntry> entries;
+
+        // Returns false when the file is missing, truncated or has a different version
+        bool read(const fs::path &file);
+        bool write(const fs::path &file) const;
+    };
+
+    // Byte range [start, end) of consecutive records of one source in a chunk,
+    // as stored in the edge index file
+    struct EdgeRef
+    {
+        uint32_t chunk;
+        uint32_t reserved;
+        uint64_t start;
+        uint64_t end;
+    };
+
+    // Persistent copy of Storage::edgeIndex, stored next to the edges folder.
+    // Every section is fixed-width and 8-byte aligned so the file is used straight
+    // from a read-only mapping: header, chunk stamp table, source table (sorted by
+    // id), the EdgeRef array the sources point into, and finally the id bytes.
+    class EdgeIndexFile
+    {
+    public:
+        unordered_map<uint32_t, ChunkStamp> chunks;
+
+        // Maps and validates the file. Returns false when it is missing or malformed.
+        bool open(const fs::path &file);
+
+        // Calls visit(sourceId, refs, refCount) for every source in the mapped file
+        template <typename Visitor>
+        void forEachSource(Visitor &&visit) const;
+
+        static bool write(const fs::path &file, const unordered_map<uint32_t, ChunkStamp> &chunks,
+                          vector<pair<string, vector<EdgeRef>>> sources);
+
+    private:
+        struct SourceEntry
+        {
+            uint64_t idOffset;
+            uint32_t idLen;
+            uint32_t reserved;
+            uint64_t firstRef;
+            uint64_t refCount;
+        };
+
+        MappedFile mapping;
+        const SourceEntry *sources = nullptr;
+        uint64_t sourceCount = 0;
+        const EdgeRef *refs = nullptr;
+        const char *ids = nullptr;
+    };
+
+    template <typename Visitor>
+    void EdgeIndexFile::forEachSource(Visitor &&visit) const
+    {
+        for (uint64_t i = 0; i < sourceCount; ++i)
+        {
+            const SourceEntry &source = sources[i];
+            visit(string_view(ids + source.idOffset, source.idLen), refs + source.firstRef, source.refCount);
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <streambuf>
+
+using namespace std;
+namespace fs = filesystem;
+
+namespace graphdb
+{
+    // Read-only memory mapping of a whole file
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        bool open(const fs::path &file);
+        void close();
+
+        bool isOpen() const { return opened; }
+        const char *data() const { return ptr; }
+        size_t size() const { return length; }
+
+        // Hints the kernel to read [offset, offset + count) ahead of use
+        void prefetch(size_t offset, size_t count) const;
+
+    private:
+        const char *ptr = nullptr;
+        size_t length = 0;
+        bool opened = false;
+#ifdef _WIN32
+        void *fileHandle = nullptr;
+        void *mappingHandle = nullptr;
+#else
+        int fd = -1;
+#endif
+    };
+
+    // Read-only stream buffer over memory owned elsewhere (typically a MappedFile),
+    // so chunk headers can be parsed from a mapping in place
+    class MemoryStreamBuf : public streambuf
+    {
+    public:
+        MemoryStreamBuf(const char *data, size_t size);
+
+    protected:
+        pos_type seekoff(off_type off, ios_base::seekdir dir, ios_base::openmode which) override;
+        pos_type seekpos(pos_type pos, ios_base::openmode which) override;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "node.hpp"
+
+using namespace std;
+
+namespace graphdb
+{
+    // Byte-budgeted cache of decoded nodes with W-TinyLFU admission. New
+    // entries go through a small LRU window; what falls out of it only enters
+    // the main segmented LRU if it has been asked for more often than the main
+    // segment's eviction victim, judged by an aging count-min sketch of recent
+    // lookups. A scan over many cold ids thus churns the window, not the hot set.
+    // Entries are weighed with PropertyValue::estimateSize. Not thread-safe;
+    // Storage uses it under storageMutex.
+    class NodeCache
+    {
+    public:
+        explicit NodeCache(size_t budgetBytes);
+
+        // Records the lookup for admission and returns the cached node, if any
+        const Node *get(const string &id);
+        void put(const Node &node);
+        void invalidate(const string &id);
+        void clear();
+
+    private:
+        enum class Segment
+        {
+            Window,
+            Probation,
+            Protected
+        };
+
+        struct Entry
+        {
+            Node node;
+            size_t bytes;
+            Segment segment;
+        };
+
+        using Lru = list<Entry>;
+
+        // Count-min sketch of 4-bit counters, halved once enough lookups were
+        // recorded so that old popularity fades
+        class FrequencySketch
+        {
+        public:
+            explicit FrequencySketch(size_t width);
+            void increment(uint64_t hash);
+            uint32_t frequency(uint64_t hash) const;
+
+        private:
+            static const size_t ROWS = 4;
+            size_t counterIndex(uint64_t hash, size_t row) const;
+
+            vector<uint64_t> table;
+            size_t mask;
+            size_t additions = 0;
+            size_t sampleSize;
+        };
+
+        static size_t weigh(const Node &node);
+        static uint64_t hashId(const string &id);
+
+        Lru &lruOf(Segment segment);
+        size_t &bytesOf(Segment segment);
+        void moveTo(Lru::iterator it, Segment segment);
+        void erase(Lru::iterator it);
+        // Moves window overflow into the main segments, admitting or dropping each candidate
+        void evictWindow();
+        void demoteProtected();
+
+        size_t windowBudget;
+        size_t mainBudget;
+        size_t protectedBudget;
+        size_t windowBytes = 0;
+        size_t probationBytes = 0;
+        size_t protectedBytes = 0;
+
+        // Front is most recently used
+        Lru window;
+        Lru probation;
+        Lru protectedLru;
+        unordered_map<string, Lru::iterator> entries;
+        FrequencySketch sketch;
+    };
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "mapped_file.hpp"
+#include "node_index.hpp"
+
+using namespace std;
+namespace fs = filesystem;
+
+namespace graphdb
+{
+    // Directory of a node chunk kept next to it ("nodes_3.bin" -> "nodes_3.ftr"):
+    // every record's id hash (hashNodeId) and offset sorted by hash, 12 bytes a
+    // record, and a bloom filter over the hashes. Index builds read it instead of
+    // decoding the chunk, and a point lookup can rule a record out without touching
+    // the chunk. Ids are not kept; like NodeIndex, callers confirm a hit against the
+    // record. Offsets are logical, so a footer stays valid when its chunk gets
+    // compressed; it records the chunk's record count and is ignored once appends change it.
+    class NodeFooter
+    {
+    public:
+        static fs::path pathFor(const fs::path &chunkFile);
+
+        // Writes and syncs the footer of a chunk holding recordCount records at the given (id hash, offset)s
+        static bool write(const fs::path &chunkFile, uint64_t recordCount, const vector<pair<uint64_t, uint32_t>> &records);
+
+        // Maps the footer; false when it is missing, damaged or describes a different record count
+        bool open(const fs::path &chunkFile, uint64_t recordCount);
+
+        size_t size() const { return entryCount; }
+        // Entries in (hash, offset) order, so the newer of two records with one id comes later
+        uint64_t hash(size_t i) const { return hashes[i]; }
+        uint32_t offset(size_t i) const { return offsets[i]; }
+
+        // False means the chunk has no record whose id has this hash
+        bool mayContain(uint64_t hash) const;
+        // Offsets of the records whose id has this hash, oldest first
+        vector<uint32_t> find(uint64_t hash) const;
+
+    private:
+        MappedFile mapping;
+        const uint64_t *hashes = nullptr;
+        const uint64_t *bloom = nullptr;
+        const uint32_t *offsets = nullptr;
+        size_t entryCount = 0;
+        uint64_t bloomBits = 0;
+        uint32_t bloomHashes = 0;
+    };
+
+    // Bounded LRU of opened footers keyed by chunk number, remembering chunks
+    // without a current footer too. An entry is reopened when the chunk's record
+    // count moves on; writers of a footer invalidate the chunk.
+    class NodeFooterCache
+    {
+    public:
+        explicit NodeFooterCache(size_t capacity);
+
+        // Footer of the chunk holding recordCount records, or null when it has none
+        shared_ptr<const NodeFooter> acquire(int chunk, const fs::path &chunkFile, uint64_t recordCount);
+        void invalidate(int chunk);
+        void clear();
+
+    private:
+        struct Entry
+        {
+            int chunk;
+            uint64_t recordCount;
+            shared_ptr<const NodeFooter> footer;
+        };
+
+        size_t capacity;
+        list<Entry> lru;
+        unordered_map<int, list<Entry>::iterator> entries;
+        mutex cacheMutex;
+    };
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace graphdb
+{
+    // FNV-1a finished with a splitmix64 round, so nearby ids spread over all bits.
+    // Stable across runs and platforms, since index files and node footers persist it.
+    uint64_t hashNodeId(string_view id);
+
+    // Where a node record lives: the chunk number of nodes_<chunk>.bin and the
+    // byte offset of the record in it. Chunks stay far below 4 GB.
+    struct NodeLocation
+    {
+        uint32_t chunk;
+        uint32_t offset;
+
+        bool operator==(const NodeLocation &other) const = default;
+    };
+
+    // Node id -> location of its live record, as a flat open-addressing table of
+    // 16-byte slots (linear probing, at most 85% full, grown by a quarter), so an
+    // index costs 19-24 bytes per node. Ids themselves are not kept: a slot holds
+    // a 64-bit hash of the id, and callers confirm a hit against the id stored in
+    // the record. Ids sharing a hash just occupy one slot each. Not thread-safe.
+    class NodeIndex
+    {
+    public:
+        static constexpr size_t NONE = SIZE_MAX;
+
+        // hashNodeId, with 0 moved to 1 because 0 marks an empty slot
+        static uint64_t hashId(string_view id) { return slotHash(hashNodeId(id)); }
+        static uint64_t slotHash(uint64_t idHash) { return idHash == 0 ? 1 : idHash; }
+
+        size_t size() const { return count; }
+        void clear();
+        // Makes room for expected entries in total, so filling up to it never rehashes
+        void reserve(size_t expected);
+
+        // Slot of the entry filed under hash whose location passes matches(location),
+        // or NONE. Slots stay valid until the next insert or erase.
+        template <typename Match>
+        size_t find(uint64_t hash, Match &&matches) const;
+
+        const NodeLocation &at(size_t slot) const { return slots[slot].location; }
+        void assign(size_t slot, NodeLocation location) { slots[slot].location = location; }
+
+        // Adds an entry without looking for an existing one for the same id
+        void insert(uint64_t hash, NodeLocation location);
+        void erase(size_t slot);
+
+        // Calls visit(hash, location) for every entry
+        template <typename Visitor>
+        void forEach(Visitor &&visit) const;
+
+    private:
+        struct Slot
+        {
+            // 0 marks an empty slot
+            uint64_t hash = 0;
+            NodeLocation location{0, 0};
+        };
+
+        // Maps the hash onto [0, capacity) without needing a power-of-two capacity
+        size_t home(uint64_t hash) const
+        {
+            return static_cast<size_t>(((hash >> 32) * static_cast<uint64_t>(slots.size())) >> 32);
+        }
+        size_t next(size_t slot) const { return slot + 1 == slots.size() ? 0 : slot + 1; }
+        void rehash(size_t capacity);
+
+        vector<Slot> slots;
+        size_t count = 0;
+    };
+
+    template <typename Match>
+    size_t NodeIndex::find(uint64_t hash, Match &&matches) const
+    {
+        if (count == 0)
+            return NONE;
+
+        for (size_t slot = home(hash); slots[slot].hash != 0; slot = next(slot))
+        {
+            if (slots[slot].hash == hash && matches(slots[slot].location))
+                return slot;
+        }
+        return NONE;
+    }
+
+    template <typename Visitor>
+    void NodeIndex::forEach(Visitor &&visit) const
+    {
+        for (const Slot &slot : slots)
+        {
+            if (slot.hash != 0)
+                visit(slot.hash, slot.location);
+        }
+    }
+}
@@ -1,43 +1,274 @@
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 #include <filesystem>
 #include "node.hpp"
 #include "edge.hpp"
+#include "chunk_cache.hpp"
+#include "node_footer.hpp"
+#include "cuckoo_filter.hpp"
+#include "node_index.hpp"
+#include "node_cache.hpp"
+#include "edge_list_cache.hpp"
+#include "csr_snapshot.hpp"
+#include "record_dictionaries.hpp"
+#include "write_ahead_log.hpp"
+#include "tombstone_file.hpp"
 
 using namespace std;
 namespace fs = filesystem;
 
 namespace graphdb
 {
+    // Consecutive edge records of one source node: the byte range [start, end) of a chunk
+    struct EdgeRun
+    {
+        string file;
+        size_t start;
+        size_t end;
+    };
+
     class Storage
     {
     public:
         Storage(const string &basePath);
-        ~Storage() = default;
+        ~Storage();
 
-        void saveNodeChunk(const vector<Node> &nodes);
-        void saveEdgeChunk(const vector<Edge> &edges);
+        // Mutations are logged to the WAL and applied to the memtable; they are
+        // durable once these return and reach the chunk files at the next checkpoint.
+        // When the log write fails they throw, and no change of the failed batch stays visible.
+        void saveNodes(const vector<Node> &nodes);
+        void saveEdges(const vector<Edge> &edges);
+        void removeNode(const string &nodeId);
+
+        // Replays the WAL left by the previous session into the memtable
+        void recoverWriteAheadLog();
+
+        // Materializes the memtable into chunk files, syncs them and empties the WAL
+        void checkpoint();
 
-        void deleteNode(const string &nodeId);
         Node loadNodeById(const string &nodeId);
+        // Existence check that never throws; misses are mostly answered by nodeFilter alone
+        bool containsNode(const string &nodeId);
+        // Edges of the source in the order they were saved
         vector<Edge> loadEdgesFromNode(const string &nodeId);
+        // Hit and miss counters of the adjacency cache behind loadEdgesFromNode
+        EdgeListCache::Stats edgeCacheStats() const;
 
         void buildNodeIndex();
         void buildEdgeIndex();
 
+        // Restores nodeIndex from the index file, rescanning only chunks changed since it was written
+        void loadNodeIndex();
+        void persistNodeIndex();
+
+        // Same as above for edgeIndex, backed by a memory-mapped index file
+        void loadEdgeIndex();
+        void persistEdgeIndex();
+
         size_t estimateNodesSize(const vector<Node> &nodes);
 
+        // Rewrites the live records of node chunks whose dead-byte ratio crossed
+        // COMPACTION_DEAD_RATIO into fresh chunks and removes the old files.
+        // bytesPerSecond == 0 disables rate limiting. Returns the number of chunks reclaimed.
+        size_t compactNodeChunks(size_t bytesPerSecond = 0);
+
+        // Rewrites runs of adjacent sealed edge chunks in which some source is split over
+        // several runs into one chunk sorted by source, so each source occupies one range.
+        // Returns the number of chunks reorganized.
+        size_t reorganizeEdgeChunks(size_t bytesPerSecond = 0);
+
+        // Writes footers for sealed node chunks that lack a current one.
+        // Returns the number of footers written.
+        size_t writeNodeFooters();
+
+        // Rewrites sealed chunks as independently compressed blocks while chunk
+        // compression is enabled. Returns the number of chunks compressed.
+        size_t compressSealedChunks(size_t bytesPerSecond = 0);
+        // Off by default; the active chunk is never compressed either way
+        void setChunkCompression(bool enabled);
+
+        // Exports the current adjacency of the box into the CSR snapshot file.
+        // Returns the number of edges written, or -1 when the file cannot be written.
+        int64_t sealSnapshot();
+        // Last sealed snapshot, mapped on first use; null when none exists
+        shared_ptr<const CsrSnapshot> snapshot();
+
+        void startBackgroundCompaction();
+        void stopBackgroundCompaction();
+        void requestCompaction();
+
     private:
+        bool saveNodeChunk(const vector<Node> &nodes);
+        bool saveEdgeChunk(const vector<Edge> &edges);
+        void deleteNode(const string &nodeId);
+
+        // Overwrites the records of one chunk whose new encoding fits their old slot,
+        // with a single write pass over the file; inPlace == false only measures the slots.
+        // The rest are handed back with their old slot, to be appended and tombstoned.
+        // Returns false when the chunk could not be written.
+        bool overwriteNodes(const string &file, const vector<pair<const Node *, size_t>> &records, bool inPlace,
+                            vector<pair<const Node *, Tombstone>> &leftovers);
+        // Counts tombstoned bytes towards waking the compactor early
+        void addDeadBytes(size_t length);
+
+        void applyNodes(const vector<Node> &nodes);
+        void applyEdges(const vector<Edge> &edges);
+        void applyDelete(const string &nodeId);
+        void applyLogRecord(WalRecordType type, const string &payload);
+        // After a failed log write: rebuilds the memtable from the durable log, so no
+        // change the caller is told failed stays visible or reaches a chunk
+        void discardUnloggedChanges();
+        void checkpointIfNeeded();
+
+        // Write the in-flight state of the checkpoint marker before the edge append,
+        // and cut that append off again when it fails or the checkpoint never finishes
+        bool recordEdgeAppend(const fs::path &file, bool createNewChunk);
+        bool undoEdgeAppend();
+        // Syncs what the in-flight checkpoint wrote and marks its log prefix materialized
+        bool finishCheckpoint();
+        // Undoes the edge append of a checkpoint a crash interrupted
+        void recoverCheckpoint();
+
+        static size_t estimateNodeSize(const Node &node);
+        static size_t estimateEdgesSize(const vector<Edge> &edges);
+        // Reads a source's runs from the chunks in adjacency order, bypassing the edge cache
+        vector<Edge> readEdgeRuns(const vector<EdgeRun> &runs);
+
+        // Appends keys and values interned since the last call to keys.dict / values.dict
+        // and syncs them. Runs before any chunk that may refer to them is written or published.
+        bool persistDictionaries();
+
+        // Open mapping of a whole chunk file, served from nodeChunks / edgeChunks.
+        // Writers drop it before touching the file, so the next read maps the grown file.
+        shared_ptr<const MappedFile> mapChunk(const string &file);
+        void unmapChunk(const string &file);
+
+        // Live records of one node chunk in file order, as (id hash, location)
+        using NodeIndexPart = vector<pair<uint64_t, NodeLocation>>;
+        using EdgeIndex = unordered_map<string, vector<EdgeRun>>;
+
+        // Scan the files on every core into per-chunk partial maps and merge those into
+        // nodeIndex / edgeIndex in chunk order, so a newer chunk wins for a repeated id
+        void indexNodeChunks(const vector<fs::path> &files);
+        void indexEdgeChunks(const vector<fs::path> &files);
+
+        // Read only the chunk and thread-safe members, so several may run at once
+        void indexNodeChunk(const fs::path &file, NodeIndexPart &part);
+        void indexEdgeChunk(const fs::path &file, EdgeIndex &index);
+
+        // nodeIndex only keeps id hashes, so every hit is confirmed against the record.
+        // findNode returns the slot of the id, or NodeIndex::NONE.
+        size_t findNode(string_view nodeId);
+        bool isNodeAt(const NodeLocation &location, string_view nodeId);
+        // Id of the record at location; empty when it cannot be read
+        string readNodeId(const NodeLocation &location);
+        // Points the id at location, adding it when it is new. Returns true when it was added.
+        bool placeNode(string_view nodeId, NodeLocation location);
+        string nodeChunkPath(uint32_t chunk) const;
+
+        // Appends a run, extending the previous run of the source when they touch
+        static void addEdgeRun(vector<EdgeRun> &runs, const string &file, size_t start, size_t end);
+
+        bool compactNodeGroup(const vector<fs::path> &victims, size_t bytesPerSecond);
+        bool reorganizeEdgeGroup(const vector<fs::path> &victims, size_t bytesPerSecond);
+        bool compressChunk(const fs::path &file, size_t bytesPerSecond);
+        void recoverCompaction();
+        // Completes or discards the pass recorded in the compaction journal
+        void finishCompactionJournal();
+
+        // Refills nodeFilter from nodeIndex, sized with room to grow
+        void rebuildNodeFilter();
+
+        // "nodes_12.bin" -> 12, or -1 when the file is not a chunk with the given prefix
+        static int chunkNumber(const fs::path &file, const string &prefix);
+
         string boxName;
-        unordered_map<string, pair<string, size_t>> nodeIndex;
-        unordered_map<string, vector<pair<string, size_t>>> edgeIndex;
+        NodeIndex nodeIndex;
+        // Holds exactly the id hashes of nodeIndex; updated wherever ids enter or leave it
+        CuckooFilter nodeFilter;
+        // One entry per run, so a source written in one batch (or reorganized) costs one entry per chunk
+        EdgeIndex edgeIndex;
+        // Active chunk of each kind; saves append to it while it has room
         int lastNodeChunkIdx;
         int lastEdgeChunkIdx;
+        // Highest chunk number handed out. New active chunks and compaction outputs both
+        // take the next one, so a compaction pass never seals a half-filled active chunk.
+        int highestNodeChunkIdx;
+        int highestEdgeChunkIdx;
 
         string NODES_BASE_PATH;
         string EDGES_BASE_PATH;
+        string NODE_INDEX_PATH;
+        string EDGE_INDEX_PATH;
+        string COMPACTION_JOURNAL_PATH;
+        string WAL_PATH;
+        string CHECKPOINT_PATH;
+        string SNAPSHOT_PATH;
+        string KEYS_PATH;
+        string VALUES_PATH;
         static const size_t MAX_CHUNK_SIZE = 1 * 1024 * 1024;
+        // Open chunk files kept per kind; bounds descriptor and address space use
+        static const size_t CHUNK_CACHE_CAPACITY = 64;
+        // Memory allowed for decoded nodes kept by loadNodeById
+        static const size_t NODE_CACHE_BYTES = 8 * 1024 * 1024;
+        // Memory allowed for decoded edge lists kept by loadEdgesFromNode
+        static const size_t EDGE_CACHE_BYTES = 8 * 1024 * 1024;
+
+        // Logged but not yet materialized state; reads consult it before the chunks
+        WriteAheadLog wal;
+        unordered_map<string, Node> pendingNodes;
+        unordered_set<string> pendingNodeDeletes;
+        unordered_map<string, vector<Edge>> pendingEdges;
+        size_t pendingBytes = 0;
+        CheckpointMarker checkpointMarker;
+        // The in-flight checkpoint's edge append failed and could not be cut off yet
+        bool edgeAppendFailed = false;
+        // Chunk and tombstone files written since the last checkpoint, synced before the WAL is emptied
+        unordered_set<string> dirtyFiles;
+
+        ChunkCache nodeChunks{CHUNK_CACHE_CAPACITY};
+        ChunkCache edgeChunks{CHUNK_CACHE_CAPACITY};
+        // Footers of sealed node chunks, which rule out index hits without decoding records
+        NodeFooterCache nodeFooters{CHUNK_CACHE_CAPACITY};
+        // Decoded copies of chunk records; dropped whenever an id is written or deleted
+        NodeCache nodeCache{NODE_CACHE_BYTES};
+        // On-disk edges of hot sources; extended by saveEdgeChunk, dropped when runs move
+        EdgeListCache edgeCache{EDGE_CACHE_BYTES};
+        shared_ptr<const CsrSnapshot> csrSnapshot;
+
+        // Key and value tables of the box; compaction encodes outside storageMutex, so they lock themselves
+        RecordDictionaries dictionaries;
+        size_t persistedKeys = 0;
+        size_t persistedValues = 0;
+        mutex dictionaryFileMutex;
+
+        // Guards the indexes and chunk files; recursive because public calls nest (save -> delete)
+        mutable recursive_mutex storageMutex;
+
+        thread compactionThread;
+        // Held for a whole pass so background and explicit passes never pick the same victims.
+        // saveNodeChunk only overwrites records in place when it can take it.
+        mutex compactionPassMutex;
+        mutex compactionMutex;
+        condition_variable compactionWakeup;
+        bool compactionRequested = false;
+        atomic<bool> compactionStopping{false};
+        size_t deadBytesSinceCompaction = 0;
+        atomic<bool> chunkCompression{false};
+
+        static constexpr double COMPACTION_DEAD_RATIO = 0.3;
+        static const size_t COMPACTION_BYTES_PER_SECOND = 4 * 1024 * 1024;
+        static constexpr chrono::seconds COMPACTION_INTERVAL{60};
     };
 }
\ No newline at end of file
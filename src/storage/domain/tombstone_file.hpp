@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+namespace fs = filesystem;
+
+namespace graphdb
+{
+    // A deleted record inside a chunk file
+    struct Tombstone
+    {
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    // Append-only list of deleted records kept next to each chunk
+    // ("nodes_3.bin" -> "nodes_3.del"). The chunk itself is never rewritten on
+    // delete; the dead bytes are reclaimed later by compaction.
+    struct TombstoneFile
+    {
+        static fs::path pathFor(const fs::path &chunkFile);
+
+        static bool append(const fs::path &chunkFile, const vector<Tombstone> &tombstones);
+        static vector<Tombstone> read(const fs::path &chunkFile);
+        static unordered_set<uint64_t> deadOffsets(const fs::path &chunkFile);
+    };
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+
+using namespace std;
+namespace fs = filesystem;
+
+namespace graphdb
+{
+    enum class WalRecordType : uint8_t
+    {
+        SaveNodes = 1,
+        SaveEdges = 2,
+        DeleteNode = 3,
+    };
+
+    // Identifies a log prefix: the byte where its last record ends and that record's
+    // crc. The crc tells a prefix of the current log apart from one of a log since emptied.
+    struct WalPosition
+    {
+        uint64_t end = 0;
+        uint32_t crc = 0;
+    };
+
+    // Progress of checkpoints, kept in "wal.ckpt" next to the log. materialized is the
+    // log prefix already in the chunk files, which replay skips. While a checkpoint is
+    // in flight, appending is the prefix it materializes and edgeFile / edgeSize /
+    // edgeCount describe the edge chunk before its append, so that append can be cut
+    // off again: edge records are not idempotent like node records and deletes are.
+    struct CheckpointMarker
+    {
+        WalPosition materialized;
+        WalPosition appending;
+        string edgeFile;
+        uint64_t edgeSize = 0;
+        uint64_t edgeCount = 0;
+
+        bool inFlight() const { return appending.end != 0; }
+
+        // A missing file reads as an empty marker; returns false only for a damaged one
+        bool read(const fs::path &file);
+        // Replaces the file atomically and syncs it
+        bool write(const fs::path &file) const;
+    };
+
+    // Append-only log of box mutations. Writers enqueue encoded records and then
+    // wait for them to become durable; whichever waiter finds no flush in flight
+    // becomes the leader and writes every queued record with a single write +
+    // fdatasync (group commit). Each record is framed as [length][crc32][type][payload].
+    class WriteAheadLog
+    {
+    public:
+        WriteAheadLog() = default;
+        ~WriteAheadLog();
+
+        WriteAheadLog(const WriteAheadLog &) = delete;
+        WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+        bool open(const fs::path &file);
+        void close();
+
+        // Calls apply(type, payload) for every intact record in order and cuts off
+        // a torn tail left by a crash. When a record ends at skipThrough, it and all
+        // records before it are skipped. Returns the number of records replayed.
+        size_t replay(const function<void(WalRecordType, const string &)> &apply, const WalPosition &skipThrough = {});
+
+        // Queues a record and returns the ticket to wait on
+        uint64_t append(WalRecordType type, const string &payload);
+        // False when the record did not make it to disk; it is then dropped for good
+        // by discardUndurable and the ticket never becomes durable
+        bool waitDurable(uint64_t ticket);
+        // Makes everything queued so far durable
+        bool flush();
+
+        // True after a failed write, until discardUndurable
+        bool failed() const;
+        // Drops queued records and cuts the file back to its last durable length,
+        // failing every ticket handed out so far that is not durable yet
+        bool discardUndurable();
+
+        // Flushes whatever is queued and empties the log. Callers make sure no
+        // append races with it (Storage holds its lock during checkpoints).
+        bool reset();
+
+        uint64_t size() const;
+        // End of the durable records
+        WalPosition position() const;
+
+    private:
+        bool writeAndSync(const string &batch);
+
+        mutable mutex walMutex;
+        condition_variable durableChanged;
+        string queued;
+        uint64_t nextTicket = 0;
+        uint64_t durableTicket = 0;
+        // Tickets in (discardedAfter, discardedThrough] were dropped after a failed write
+        uint64_t discardedAfter = 0;
+        uint64_t discardedThrough = 0;
+        uint64_t bytesOnDisk = 0;
+        // crc of the last record in the durable part, and of the last queued one
+        uint32_t lastDurableCrc = 0;
+        uint32_t lastQueuedCrc = 0;
+        bool flushing = false;
+        bool broken = false;
+        fs::path path;
+        int fd = -1;
+    };
+
+    // Flushes a file's data to stable storage
+    bool syncFile(const fs::path &file);
+}
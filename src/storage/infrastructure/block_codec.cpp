@@ -0,0 +1,176 @@
+#include "block_codec.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    const size_t MIN_MATCH = 4;
+    // The format keeps the last bytes of a block as literals
+    const size_t LAST_LITERALS = 5;
+    const size_t MATCH_SEARCH_LIMIT = 12;
+    const int HASH_BITS = 12;
+    const size_t MAX_DISTANCE = 65535;
+
+    uint32_t read32(const char *p)
+    {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    uint32_t hashSequence(uint32_t sequence)
+    {
+        return (sequence * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    char *writeLengthTail(char *op, size_t length)
+    {
+        while (length >= 255)
+        {
+            *op++ = static_cast<char>(255);
+            length -= 255;
+        }
+        *op++ = static_cast<char>(length);
+        return op;
+    }
+
+    char *writeSequence(char *op, const char *literals, size_t literalLength, size_t distance, size_t matchLength)
+    {
+        char *token = op++;
+        uint8_t tokenValue = static_cast<uint8_t>(min<size_t>(literalLength, 15) << 4);
+        if (literalLength >= 15)
+            op = writeLengthTail(op, literalLength - 15);
+
+        memcpy(op, literals, literalLength);
+        op += literalLength;
+
+        if (matchLength > 0)
+        {
+            uint16_t offset = static_cast<uint16_t>(distance);
+            memcpy(op, &offset, sizeof(offset));
+            op += sizeof(offset);
+
+            size_t extra = matchLength - MIN_MATCH;
+            tokenValue |= static_cast<uint8_t>(min<size_t>(extra, 15));
+            if (extra >= 15)
+                op = writeLengthTail(op, extra - 15);
+        }
+        *token = static_cast<char>(tokenValue);
+        return op;
+    }
+
+    bool readLengthTail(const char *&ip, const char *end, size_t &length)
+    {
+        uint8_t byte;
+        do
+        {
+            if (ip >= end)
+                return false;
+            byte = static_cast<uint8_t>(*ip++);
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+}
+
+namespace graphdb
+{
+    namespace BlockCodec
+    {
+        size_t compressBound(size_t n)
+        {
+            return n + n / 255 + 16;
+        }
+
+        size_t compress(const char *src, size_t n, char *dst)
+        {
+            char *op = dst;
+            size_t anchor = 0;
+
+            if (n > MATCH_SEARCH_LIMIT)
+            {
+                vector<uint32_t> table(size_t(1) << HASH_BITS, UINT32_MAX);
+                size_t limit = n - MATCH_SEARCH_LIMIT;
+                size_t ip = 0;
+
+                while (ip < limit)
+                {
+                    uint32_t sequence = read32(src + ip);
+                    uint32_t &slot = table[hashSequence(sequence)];
+                    size_t ref = slot;
+                    slot = static_cast<uint32_t>(ip);
+
+                    if (ref == UINT32_MAX || ip - ref > MAX_DISTANCE || read32(src + ref) != sequence)
+                    {
+                        ++ip;
+                        continue;
+                    }
+
+                    size_t matchLength = MIN_MATCH;
+                    while (ip + matchLength < n - LAST_LITERALS && src[ref + matchLength] == src[ip + matchLength])
+                        ++matchLength;
+
+                    op = writeSequence(op, src + anchor, ip - anchor, ip - ref, matchLength);
+                    ip += matchLength;
+                    anchor = ip;
+                }
+            }
+
+            op = writeSequence(op, src + anchor, n - anchor, 0, 0);
+            return static_cast<size_t>(op - dst);
+        }
+
+        bool decompress(const char *src, size_t n, char *dst, size_t outSize)
+        {
+            const char *ip = src;
+            const char *end = src + n;
+            char *op = dst;
+            char *outEnd = dst + outSize;
+
+            while (ip < end)
+            {
+                uint8_t token = static_cast<uint8_t>(*ip++);
+
+                size_t literalLength = token >> 4;
+                if (literalLength == 15 && !readLengthTail(ip, end, literalLength))
+                    return false;
+                if (literalLength > static_cast<size_t>(end - ip) || literalLength > static_cast<size_t>(outEnd - op))
+                    return false;
+                memcpy(op, ip, literalLength);
+                ip += literalLength;
+                op += literalLength;
+
+                // The last sequence carries literals only
+                if (ip == end)
+                    break;
+
+                if (end - ip < 2)
+                    return false;
+                uint16_t distance;
+                memcpy(&distance, ip, sizeof(distance));
+                ip += sizeof(distance);
+                if (distance == 0 || distance > op - dst)
+                    return false;
+
+                size_t matchLength = token & 0x0F;
+                if (matchLength == 15 && !readLengthTail(ip, end, matchLength))
+                    return false;
+                matchLength += MIN_MATCH;
+                if (matchLength > static_cast<size_t>(outEnd - op))
+                    return false;
+
+                // Byte by byte: a match may overlap the output it copies from
+                const char *match = op - distance;
+                for (size_t i = 0; i < matchLength; ++i)
+                    op[i] = match[i];
+                op += matchLength;
+            }
+
+            return op == outEnd;
+        }
+    }
+}
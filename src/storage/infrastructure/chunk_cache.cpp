@@ -0,0 +1,54 @@
+#include "chunk_cache.hpp"
+
+using namespace std;
+using namespace graphdb;
+
+ChunkCache::ChunkCache(size_t capacity)
+    : capacity(capacity)
+{
+}
+
+shared_ptr<const MappedFile> ChunkCache::acquire(int chunk, const fs::path &file)
+{
+    lock_guard<mutex> lock(cacheMutex);
+
+    auto it = entries.find(chunk);
+    if (it != entries.end())
+    {
+        lru.splice(lru.begin(), lru, it->second);
+        return it->second->second;
+    }
+
+    auto mapping = make_shared<MappedFile>();
+    if (!mapping->open(file))
+        return nullptr;
+
+    lru.emplace_front(chunk, mapping);
+    entries[chunk] = lru.begin();
+
+    while (lru.size() > capacity)
+    {
+        entries.erase(lru.back().first);
+        lru.pop_back();
+    }
+    return mapping;
+}
+
+void ChunkCache::invalidate(int chunk)
+{
+    lock_guard<mutex> lock(cacheMutex);
+
+    auto it = entries.find(chunk);
+    if (it == entries.end())
+        return;
+
+    lru.erase(it->second);
+    entries.erase(it);
+}
+
+void ChunkCache::clear()
+{
+    lock_guard<mutex> lock(cacheMutex);
+    lru.clear();
+    entries.clear();
+}
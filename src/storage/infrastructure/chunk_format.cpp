@@ -0,0 +1,278 @@
+#include "chunk_format.hpp"
+#include "block_codec.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+using namespace std;
+using namespace graphdb;
+
+namespace
+{
+    const char CHUNK_MAGIC[4] = {'G', 'D', 'B', 'C'};
+    const size_t V2_HEADER_SIZE = 16;
+
+    // Follows the header of a compressed chunk, ahead of blockCount + 1 block offsets
+    struct BlockDirectory
+    {
+        uint64_t logicalSize;
+        uint32_t blockSize;
+        uint32_t blockCount;
+    };
+
+    static_assert(sizeof(BlockDirectory) == 16, "block directory must keep its on-disk size");
+}
+
+bool ChunkHeader::read(istream &in)
+{
+    char first[8];
+    if (!in.read(first, sizeof(first)))
+        return false;
+
+    if (memcmp(first, CHUNK_MAGIC, sizeof(CHUNK_MAGIC)) != 0)
+    {
+        format = RecordFormat::V1;
+        flags = 0;
+        memcpy(&count, first, sizeof(count));
+        return true;
+    }
+
+    uint16_t version;
+    memcpy(&version, first + 4, sizeof(version));
+    memcpy(&flags, first + 6, sizeof(flags));
+    if (version < static_cast<uint16_t>(RecordFormat::V2) || version > static_cast<uint16_t>(CURRENT_RECORD_FORMAT))
+        return false;
+
+    format = static_cast<RecordFormat>(version);
+    return static_cast<bool>(in.read(reinterpret_cast<char *>(&count), sizeof(count)));
+}
+
+void ChunkHeader::write(ostream &out) const
+{
+    if (format == RecordFormat::V1)
+    {
+        size_t legacyCount = count;
+        out.write(reinterpret_cast<const char *>(&legacyCount), sizeof(legacyCount));
+        return;
+    }
+
+    uint16_t version = static_cast<uint16_t>(format);
+    out.write(CHUNK_MAGIC, sizeof(CHUNK_MAGIC));
+    out.write(reinterpret_cast<const char *>(&version), sizeof(version));
+    out.write(reinterpret_cast<const char *>(&flags), sizeof(flags));
+    out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+}
+
+bool graphdb::writeCompressedChunk(const MappedFile &source, const fs::path &target)
+{
+    MemoryStreamBuf sourceBuf(source.data(), source.size());
+    istream sourceIn(&sourceBuf);
+    ChunkHeader header;
+    // v1 chunks have no flags to mark compression with
+    if (!header.read(sourceIn) || header.format == RecordFormat::V1 || header.compressed())
+        return false;
+
+    BlockDirectory directory{source.size(), COMPRESSED_BLOCK_SIZE,
+                             static_cast<uint32_t>((source.size() + COMPRESSED_BLOCK_SIZE - 1) / COMPRESSED_BLOCK_SIZE)};
+
+    vector<uint64_t> offsets;
+    offsets.reserve(directory.blockCount + 1);
+    uint64_t position = V2_HEADER_SIZE + sizeof(directory) + (directory.blockCount + 1) * sizeof(uint64_t);
+
+    string blocks;
+    vector<char> scratch(BlockCodec::compressBound(COMPRESSED_BLOCK_SIZE));
+    for (uint32_t i = 0; i < directory.blockCount; ++i)
+    {
+        const char *raw = source.data() + static_cast<size_t>(i) * COMPRESSED_BLOCK_SIZE;
+        size_t rawLength = min<size_t>(COMPRESSED_BLOCK_SIZE, source.size() - static_cast<size_t>(i) * COMPRESSED_BLOCK_SIZE);
+
+        size_t compressedLength = BlockCodec::compress(raw, rawLength, scratch.data());
+        offsets.push_back(position + blocks.size());
+        if (compressedLength < rawLength)
+            blocks.append(scratch.data(), compressedLength);
+        else
+            blocks.append(raw, rawLength);
+    }
+    offsets.push_back(position + blocks.size());
+
+    ofstream out(target, ios::binary | ios::trunc);
+    header.flags |= CHUNK_FLAG_COMPRESSED;
+    header.write(out);
+    out.write(reinterpret_cast<const char *>(&directory), sizeof(directory));
+    out.write(reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(uint64_t));
+    out.write(blocks.data(), blocks.size());
+    out.close();
+    return !out.fail();
+}
+
+uint64_t graphdb::logicalChunkSize(const fs::path &file)
+{
+    error_code ec;
+    uint64_t size = fs::file_size(file, ec);
+    if (ec)
+        return 0;
+
+    ifstream in(file, ios::binary);
+    ChunkHeader header;
+    BlockDirectory directory;
+    if (header.read(in) && header.format != RecordFormat::V1 && header.compressed() &&
+        in.read(reinterpret_cast<char *>(&directory), sizeof(directory)))
+        return directory.logicalSize;
+    return size;
+}
+
+ChunkReader::ChunkReader(const MappedFile &mapping, const RecordDictionaries *dicts)
+    : mapping(mapping), dicts(dicts), logicalSize(mapping.size())
+{
+    MemoryStreamBuf buf(mapping.data(), mapping.size());
+    istream in(&buf);
+    headerValid = chunkHeader.read(in);
+    if (headerValid && chunkHeader.format != RecordFormat::V1 && chunkHeader.compressed())
+        headerValid = openBlocks();
+    // Records start right after the header in the uncompressed bytes too
+    position = chunkHeader.size();
+}
+
+bool ChunkReader::openBlocks()
+{
+    BlockDirectory directory;
+    if (mapping.size() < V2_HEADER_SIZE + sizeof(directory))
+        return false;
+    memcpy(&directory, mapping.data() + V2_HEADER_SIZE, sizeof(directory));
+
+    uint64_t offsetsAt = V2_HEADER_SIZE + sizeof(directory);
+    if (directory.blockSize == 0 || directory.blockCount == 0 ||
+        directory.logicalSize > uint64_t(directory.blockCount) * directory.blockSize ||
+        directory.logicalSize <= uint64_t(directory.blockCount - 1) * directory.blockSize ||
+        (mapping.size() - offsetsAt) / sizeof(uint64_t) < uint64_t(directory.blockCount) + 1)
+        return false;
+
+    // Mappings are page aligned, so the offset table is naturally aligned as well
+    const uint64_t *offsets = reinterpret_cast<const uint64_t *>(mapping.data() + offsetsAt);
+    for (uint32_t i = 0; i < directory.blockCount; ++i)
+    {
+        if (offsets[i] > offsets[i + 1] || offsets[i + 1] > mapping.size())
+            return false;
+    }
+
+    blockOffsets = offsets;
+    blockCount = directory.blockCount;
+    blockSize = directory.blockSize;
+    logicalSize = directory.logicalSize;
+    return true;
+}
+
+void ChunkReader::seek(size_t offset)
+{
+    failed = false;
+    position = offset;
+}
+
+bool ChunkReader::decodeWindow(size_t first, size_t last)
+{
+    window.resize((last - first + 1) * blockSize);
+    size_t filled = 0;
+    for (size_t index = first; index <= last; ++index)
+    {
+        size_t rawLength = static_cast<size_t>(min<uint64_t>(blockSize, logicalSize - index * blockSize));
+        size_t storedLength = static_cast<size_t>(blockOffsets[index + 1] - blockOffsets[index]);
+        const char *stored = mapping.data() + blockOffsets[index];
+
+        // Blocks that did not shrink are stored verbatim
+        bool ok = storedLength == rawLength ? (memcpy(window.data() + filled, stored, rawLength), true)
+                                            : BlockCodec::decompress(stored, storedLength, window.data() + filled, rawLength);
+        if (!ok)
+        {
+            window.clear();
+            return false;
+        }
+        filled += rawLength;
+    }
+
+    window.resize(filled);
+    windowStart = first * blockSize;
+    return true;
+}
+
+BinaryReader ChunkReader::bytesAt(size_t minBytes)
+{
+    BinaryReader in;
+    if (!blockOffsets)
+    {
+        in = BinaryReader(as_bytes(span(mapping.data(), mapping.size())));
+    }
+    else
+    {
+        size_t wanted = static_cast<size_t>(min<uint64_t>(logicalSize, position + min<uint64_t>(minBytes, logicalSize)));
+        bool covered = !window.empty() && position >= windowStart && wanted <= windowStart + window.size();
+        if (!covered && position < logicalSize &&
+            !decodeWindow(position / blockSize, (max(wanted, position + 1) - 1) / blockSize))
+        {
+            in.fail();
+            return in;
+        }
+        in = BinaryReader(as_bytes(span(window.data(), window.size())), windowStart);
+    }
+
+    in.seek(position);
+    return in;
+}
+
+template <typename Decode>
+auto ChunkReader::decodeAt(Decode &&decode)
+{
+    BinaryReader in = bytesAt(blockSize);
+    auto record = decode(in);
+    if (!in && blockOffsets && windowStart + window.size() < logicalSize)
+    {
+        in = bytesAt(SIZE_MAX);
+        record = decode(in);
+    }
+
+    if (in)
+        position = in.tell();
+    else
+        failed = true;
+    return record;
+}
+
+Node ChunkReader::readNode()
+{
+    return decodeAt([&](BinaryReader &in) { return Node::deserialize(in, chunkHeader.format, dicts); });
+}
+
+Edge ChunkReader::readEdge()
+{
+    return decodeAt([&](BinaryReader &in) { return Edge::deserialize(in, chunkHeader.format, dicts); });
+}
+
+NodeView ChunkReader::readNodeView()
+{
+    return decodeAt([&](BinaryReader &in) { return NodeView::read(in, chunkHeader.format); });
+}
+
+EdgeView ChunkReader::readEdgeView()
+{
+    return decodeAt([&](BinaryReader &in) { return EdgeView::read(in, chunkHeader.format); });
+}
+
+size_t ChunkReader::readLength()
+{
+    return decodeAt([&](BinaryReader &in) { return graphdb::readLength(in, chunkHeader.format); });
+}
+
+void ChunkReader::prefetch(size_t offset, size_t count) const
+{
+    if (!blockOffsets)
+    {
+        mapping.prefetch(offset, count);
+        return;
+    }
+    if (count == 0)
+        return;
+
+    uint64_t first = min<uint64_t>(offset / blockSize, blockCount - 1);
+    uint64_t last = min<uint64_t>((offset + count - 1) / blockSize, blockCount - 1);
+    mapping.prefetch(blockOffsets[first], blockOffsets[last + 1] - blockOffsets[first]);
+}
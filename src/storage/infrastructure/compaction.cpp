@@ -0,0 +1,811 @@
+#include "storage.hpp"
+#include "tombstone_file.hpp"
+#include "node_footer.hpp"
+#include "chunk_format.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <tuple>
+#include <unordered_set>
+
+using namespace std;
+using namespace graphdb;
+
+namespace
+{
+    // Spreads compaction I/O over time so foreground lookups keep a flat latency
+    class RateLimiter
+    {
+    public:
+        explicit RateLimiter(size_t bytesPerSecond)
+            : bytesPerSecond(bytesPerSecond), start(chrono::steady_clock::now()) {}
+
+        void consume(size_t bytes)
+        {
+            if (bytesPerSecond == 0)
+                return;
+
+            consumed += bytes;
+            auto due = start + chrono::microseconds(consumed * 1000000 / bytesPerSecond);
+            if (due > chrono::steady_clock::now())
+                this_thread::sleep_until(due);
+        }
+
+    private:
+        size_t bytesPerSecond;
+        size_t consumed = 0;
+        chrono::steady_clock::time_point start;
+    };
+
+    struct CompactionCandidate
+    {
+        fs::path file;
+        uint64_t liveBytes;
+        double deadRatio;
+    };
+
+    // A live record copied from a victim chunk into the compaction output
+    struct MovedRecord
+    {
+        string id;
+        NodeLocation oldLocation;
+        uint64_t newOffset;
+        uint64_t length;
+    };
+}
+
+// ====================== BACKGROUND THREAD ======================
+void Storage::startBackgroundCompaction()
+{
+    lock_guard<mutex> lock(compactionMutex);
+    if (compactionThread.joinable())
+        return;
+
+    compactionStopping = false;
+    compactionThread = thread([this]
+    {
+        unique_lock<mutex> lock(compactionMutex);
+        while (!compactionStopping)
+        {
+            compactionWakeup.wait_for(lock, COMPACTION_INTERVAL, [this] { return compactionStopping || compactionRequested; });
+            if (compactionStopping)
+                break;
+            compactionRequested = false;
+
+            lock.unlock();
+            try
+            {
+                compactNodeChunks(COMPACTION_BYTES_PER_SECOND);
+                reorganizeEdgeChunks(COMPACTION_BYTES_PER_SECOND);
+                writeNodeFooters();
+                compressSealedChunks(COMPACTION_BYTES_PER_SECOND);
+            }
+            catch (const exception &e)
+            {
+                printf("compaction: ERROR - Exception caught: %s\n", e.what());
+                fflush(stdout);
+            }
+            lock.lock();
+        }
+    });
+}
+
+void Storage::stopBackgroundCompaction()
+{
+    {
+        lock_guard<mutex> lock(compactionMutex);
+        compactionStopping = true;
+    }
+    compactionWakeup.notify_all();
+
+    if (compactionThread.joinable())
+        compactionThread.join();
+}
+
+void Storage::requestCompaction()
+{
+    {
+        lock_guard<mutex> lock(compactionMutex);
+        compactionRequested = true;
+    }
+    compactionWakeup.notify_all();
+}
+
+// ====================== COMPACT NODE CHUNKS ======================
+size_t Storage::compactNodeChunks(size_t bytesPerSecond)
+{
+    lock_guard<mutex> pass(compactionPassMutex);
+
+    vector<CompactionCandidate> candidates;
+    {
+        lock_guard<recursive_mutex> lock(storageMutex);
+        deadBytesSinceCompaction = 0;
+
+        for (const auto &entry : fs::directory_iterator(NODES_BASE_PATH))
+        {
+            int chunk = chunkNumber(entry.path(), "nodes");
+            // The active chunk still receives appends and is left alone
+            if (chunk < 0 || chunk == lastNodeChunkIdx)
+                continue;
+
+            // Tombstones count uncompressed bytes
+            uint64_t size = logicalChunkSize(entry.path());
+            uint64_t deadBytes = 0;
+            for (const auto &tombstone : TombstoneFile::read(entry.path()))
+                deadBytes += tombstone.length;
+            if (size == 0 || deadBytes == 0)
+                continue;
+
+            double ratio = static_cast<double>(deadBytes) / static_cast<double>(size);
+            if (ratio >= COMPACTION_DEAD_RATIO)
+                candidates.push_back({entry.path(), size - min(size, deadBytes), ratio});
+        }
+    }
+
+    if (candidates.empty())
+        return 0;
+
+    // Most wasteful chunks first, packed into groups that fit a single output chunk
+    sort(candidates.begin(), candidates.end(),
+         [](const auto &a, const auto &b) { return a.deadRatio > b.deadRatio; });
+
+    vector<vector<fs::path>> groups;
+    uint64_t groupBytes = 0;
+    for (const auto &candidate : candidates)
+    {
+        if (groups.empty() || groupBytes + candidate.liveBytes > MAX_CHUNK_SIZE)
+        {
+            groups.emplace_back();
+            groupBytes = 0;
+        }
+        groups.back().push_back(candidate.file);
+        groupBytes += candidate.liveBytes;
+    }
+
+    size_t reclaimed = 0;
+    for (const auto &group : groups)
+    {
+        if (compactionStopping)
+            break;
+        if (compactNodeGroup(group, bytesPerSecond))
+            reclaimed += group.size();
+    }
+
+    printf("compactNodeChunks: Reclaimed %zu of %zu candidate chunk(s).\n", reclaimed, candidates.size());
+    fflush(stdout);
+    return reclaimed;
+}
+
+bool Storage::compactNodeGroup(const vector<fs::path> &victims, size_t bytesPerSecond)
+{
+    // Reserve a chunk number; the write path never appends to a chunk that does not exist yet
+    int outputChunk;
+    {
+        lock_guard<recursive_mutex> lock(storageMutex);
+        outputChunk = ++highestNodeChunkIdx;
+    }
+
+    fs::path tmpFile = fs::path(NODES_BASE_PATH) / ("compact_" + to_string(outputChunk) + ".tmp");
+    fs::path outFile = fs::path(NODES_BASE_PATH) / ("nodes_" + to_string(outputChunk) + ".bin");
+
+    // 1. Copy live records without holding the storage lock. Victims are sealed,
+    //    so the only thing that can change underneath is their tombstone files.
+    RateLimiter limiter(bytesPerSecond);
+    vector<MovedRecord> moved;
+    {
+        ofstream out(tmpFile, ios::binary | ios::trunc);
+        if (!out)
+        {
+            printf("compactNodeGroup: Cannot open output file: %s\n", tmpFile.string().c_str());
+            fflush(stdout);
+            return false;
+        }
+
+        // Victims are deleted after the swap, so anything short of a full copy aborts the group
+        auto abandon = [&](const char *reason, const fs::path &file)
+        {
+            printf("compactNodeGroup: %s %s, leaving group as is.\n", reason, file.string().c_str());
+            fflush(stdout);
+            out.close();
+            fs::remove(tmpFile);
+            return false;
+        };
+
+        // Output is always written in the current format, which also migrates older chunks
+        ChunkHeader header;
+        header.write(out);
+
+        // Each victim's live records are encoded into one buffer and written with a single call
+        BinaryWriter records;
+        for (const auto &victim : victims)
+        {
+            uint64_t base = static_cast<uint64_t>(out.tellp());
+            records.clear();
+
+            auto mapping = mapChunk(victim.string());
+            if (!mapping)
+                return abandon("Cannot read", victim);
+
+            ChunkReader reader(*mapping, &dictionaries);
+            if (!reader.valid())
+                return abandon("Cannot read", victim);
+
+            uint32_t victimChunk = static_cast<uint32_t>(chunkNumber(victim, "nodes"));
+            auto deadOffsets = TombstoneFile::deadOffsets(victim);
+            for (size_t i = 0; i < reader.header().count; ++i)
+            {
+                if (compactionStopping)
+                    return abandon("Stopping, discarding copy of", victim);
+
+                uint64_t offset = reader.tell();
+                Node node = reader.readNode();
+                if (!reader.good())
+                    return abandon("Truncated record in", victim);
+                limiter.consume(reader.tell() - offset);
+
+                if (deadOffsets.count(offset))
+                    continue;
+
+                uint64_t start = records.size();
+                node.serialize(records, header.format, &dictionaries);
+                moved.push_back({node.id, {victimChunk, static_cast<uint32_t>(offset)}, base + start, records.size() - start});
+            }
+            // The node index stores 32-bit offsets
+            if (base + records.size() > UINT32_MAX)
+                return abandon("Output too large for", victim);
+            out.write(records.data(), records.size());
+        }
+
+        header.count = moved.size();
+        out.seekp(0, ios::beg);
+        header.write(out);
+        out.close();
+        if (out.fail() || !persistDictionaries())
+        {
+            printf("compactNodeGroup: Write failed for %s\n", tmpFile.string().c_str());
+            fflush(stdout);
+            fs::remove(tmpFile);
+            return false;
+        }
+    }
+
+    // 2. Swap under the lock: publish the new chunk, repoint the index, drop the victims
+    lock_guard<recursive_mutex> lock(storageMutex);
+
+    if (moved.empty())
+    {
+        fs::remove(tmpFile);
+    }
+    else
+    {
+        // The journal lets the next open finish (or forget) a swap interrupted by a crash
+        ofstream journal(COMPACTION_JOURNAL_PATH, ios::trunc);
+        journal << "output " << outFile.string() << "\n";
+        for (const auto &victim : victims)
+            journal << "victim " << victim.string() << "\n";
+        journal.close();
+        if (journal.fail())
+        {
+            printf("compactNodeGroup: Cannot write journal %s, leaving group as is.\n", COMPACTION_JOURNAL_PATH.c_str());
+            fflush(stdout);
+            fs::remove(tmpFile);
+            return false;
+        }
+
+        // Records deleted or re-saved while they were being copied are dead in the new chunk too.
+        // Their tombstones land before the chunk is published so a crash cannot revive them.
+        // A record still indexed at its old location is the live one; no id needs reading back
+        auto indexedAt = [&](const MovedRecord &record)
+        {
+            return nodeIndex.find(NodeIndex::hashId(record.id), [&](const NodeLocation &location)
+                                  { return location == record.oldLocation; });
+        };
+        vector<Tombstone> orphaned;
+        for (const auto &record : moved)
+        {
+            if (indexedAt(record) == NodeIndex::NONE)
+                orphaned.push_back({record.newOffset, record.length});
+        }
+        TombstoneFile::append(outFile, orphaned);
+
+        // Victims are removed right after, so the copy has to be on stable storage first
+        if (!syncFile(tmpFile) || (!orphaned.empty() && !syncFile(TombstoneFile::pathFor(outFile))))
+        {
+            printf("compactNodeGroup: Cannot sync %s, leaving group as is.\n", tmpFile.string().c_str());
+            fflush(stdout);
+            fs::remove(tmpFile);
+            fs::remove(TombstoneFile::pathFor(outFile));
+            fs::remove(COMPACTION_JOURNAL_PATH);
+            return false;
+        }
+        fs::rename(tmpFile, outFile);
+
+        vector<pair<uint64_t, uint32_t>> records;
+        records.reserve(moved.size());
+        for (const auto &record : moved)
+        {
+            size_t slot = indexedAt(record);
+            if (slot != NodeIndex::NONE)
+                nodeIndex.assign(slot, {static_cast<uint32_t>(outputChunk), static_cast<uint32_t>(record.newOffset)});
+            records.emplace_back(hashNodeId(record.id), static_cast<uint32_t>(record.newOffset));
+        }
+
+        // The output is complete, so its footer can be written right away; a failure
+        // only means the next maintenance pass writes it
+        NodeFooter::write(outFile, moved.size(), records);
+        nodeFooters.invalidate(outputChunk);
+    }
+
+    for (const auto &victim : victims)
+    {
+        // Mapped files cannot be removed on Windows
+        unmapChunk(victim.string());
+        fs::remove(victim);
+        fs::remove(TombstoneFile::pathFor(victim));
+        fs::remove(NodeFooter::pathFor(victim));
+        // A pending checkpoint must not wait on files that no longer exist
+        dirtyFiles.erase(victim.string());
+        dirtyFiles.erase(TombstoneFile::pathFor(victim).string());
+    }
+    fs::remove(COMPACTION_JOURNAL_PATH);
+
+    printf("compactNodeGroup: Merged %zu chunk(s) into %s (%zu live records).\n", victims.size(), outFile.string().c_str(), moved.size());
+    fflush(stdout);
+    return true;
+}
+
+// ====================== REORGANIZE EDGE CHUNKS ======================
+size_t Storage::reorganizeEdgeChunks(size_t bytesPerSecond)
+{
+    lock_guard<mutex> pass(compactionPassMutex);
+
+    // Every chunk that holds runs, in order, with whether it is worth rewriting
+    vector<tuple<int, fs::path, bool>> chunks;
+    size_t candidates = 0;
+    {
+        lock_guard<recursive_mutex> lock(storageMutex);
+
+        // A chunk is worth rewriting when some source owns more than one run in it
+        unordered_map<string, pair<size_t, size_t>> runsAndSources;
+        for (const auto &[from, runs] : edgeIndex)
+        {
+            unordered_map<string, size_t> perChunk;
+            for (const auto &run : runs)
+                ++perChunk[run.file];
+            for (const auto &[file, count] : perChunk)
+            {
+                auto &stats = runsAndSources[file];
+                stats.first += count;
+                stats.second += 1;
+            }
+        }
+
+        for (const auto &[file, stats] : runsAndSources)
+        {
+            int chunk = chunkNumber(file, "edges");
+            // The active chunk still receives appends and is left alone
+            bool candidate = chunk >= 0 && chunk != lastEdgeChunkIdx && stats.first > stats.second;
+            chunks.emplace_back(chunk, file, candidate);
+            candidates += candidate;
+        }
+    }
+
+    if (candidates == 0)
+        return 0;
+
+    // Oldest chunks first, packed into groups that fit a single output chunk. A group
+    // only spans adjacent chunks: its output takes the place of the oldest one, so
+    // reading runs by chunk number keeps returning every source's edges in write order.
+    sort(chunks.begin(), chunks.end());
+
+    vector<vector<fs::path>> groups;
+    uint64_t groupBytes = 0;
+    bool adjacent = false;
+    for (const auto &[chunk, file, candidate] : chunks)
+    {
+        uint64_t size = candidate ? logicalChunkSize(file) : 0;
+        if (size == 0)
+        {
+            adjacent = false;
+            continue;
+        }
+
+        if (!adjacent || groupBytes + size > MAX_CHUNK_SIZE)
+        {
+            groups.emplace_back();
+            groupBytes = 0;
+        }
+        groups.back().push_back(file);
+        groupBytes += size;
+        adjacent = true;
+    }
+
+    size_t reorganized = 0;
+    for (const auto &group : groups)
+    {
+        if (compactionStopping)
+            break;
+        if (reorganizeEdgeGroup(group, bytesPerSecond))
+            reorganized += group.size();
+    }
+
+    printf("reorganizeEdgeChunks: Reorganized %zu of %zu candidate chunk(s).\n", reorganized, candidates);
+    fflush(stdout);
+    return reorganized;
+}
+
+bool Storage::reorganizeEdgeGroup(const vector<fs::path> &victims, size_t bytesPerSecond)
+{
+    // The output replaces the oldest victim under its name, keeping its place in the read order
+    const fs::path &outFile = victims.front();
+    fs::path tmpFile = fs::path(EDGES_BASE_PATH) / ("compact_" + to_string(chunkNumber(outFile, "edges")) + ".tmp");
+
+    // 1. Read every record of the group without holding the storage lock. Edge chunks
+    //    are never rewritten in place, so sealed victims cannot change underneath.
+    RateLimiter limiter(bytesPerSecond);
+    vector<Edge> edges;
+    unordered_set<string> victimSources;
+    for (const auto &victim : victims)
+    {
+        auto mapping = mapChunk(victim.string());
+        if (!mapping)
+        {
+            printf("reorganizeEdgeGroup: Cannot read %s, leaving group as is.\n", victim.string().c_str());
+            fflush(stdout);
+            return false;
+        }
+
+        ChunkReader reader(*mapping, &dictionaries);
+
+        auto deadOffsets = TombstoneFile::deadOffsets(victim);
+        for (size_t i = 0; reader.valid() && i < reader.header().count && reader.good(); ++i)
+        {
+            if (compactionStopping)
+                return false;
+
+            uint64_t offset = reader.tell();
+            Edge e = reader.readEdge();
+            if (!reader.good())
+                break;
+            limiter.consume(reader.tell() - offset);
+
+            victimSources.insert(e.from);
+            if (!deadOffsets.count(offset))
+                edges.push_back(move(e));
+        }
+
+        if (!reader.valid() || !reader.good())
+        {
+            printf("reorganizeEdgeGroup: Truncated record in %s, leaving group as is.\n", victim.string().c_str());
+            fflush(stdout);
+            return false;
+        }
+    }
+
+    // 2. Write them sorted by source; the order of a source's edges is preserved
+    stable_sort(edges.begin(), edges.end(),
+                [](const Edge &a, const Edge &b) { return a.from < b.from; });
+
+    vector<EdgeRun> runs;
+    vector<string> runSources;
+    {
+        ofstream out(tmpFile, ios::binary | ios::trunc);
+        ChunkHeader header;
+        header.count = edges.size();
+        header.write(out);
+
+        // The whole group is encoded into one buffer and written with a single call
+        size_t base = header.size();
+        BinaryWriter records;
+        for (size_t i = 0; i < edges.size(); ++i)
+        {
+            size_t offset = base + records.size();
+            if (i == 0 || edges[i].from != edges[i - 1].from)
+            {
+                runs.push_back({outFile.string(), offset, offset});
+                runSources.push_back(edges[i].from);
+            }
+            edges[i].serialize(records, header.format, &dictionaries);
+            runs.back().end = base + records.size();
+        }
+        out.write(records.data(), records.size());
+        out.close();
+
+        if (out.fail() || !persistDictionaries() || !syncFile(tmpFile))
+        {
+            printf("reorganizeEdgeGroup: Write failed for %s\n", tmpFile.string().c_str());
+            fflush(stdout);
+            fs::remove(tmpFile);
+            return false;
+        }
+    }
+
+    // 3. Swap under the lock: publish the new chunk, replace the victims' runs, drop the victims
+    lock_guard<recursive_mutex> lock(storageMutex);
+
+    // Once the journal names the staged output, recovery finishes the swap after a crash
+    ofstream journal(COMPACTION_JOURNAL_PATH, ios::trunc);
+    journal << "output " << outFile.string() << "\n";
+    journal << "staged " << tmpFile.string() << "\n";
+    for (const auto &victim : victims)
+        journal << "victim " << victim.string() << "\n";
+    journal.close();
+    if (journal.fail())
+    {
+        printf("reorganizeEdgeGroup: Cannot write journal %s, leaving group as is.\n", COMPACTION_JOURNAL_PATH.c_str());
+        fflush(stdout);
+        fs::remove(tmpFile);
+        return false;
+    }
+
+    // Mapped files cannot be removed or replaced on Windows
+    for (const auto &victim : victims)
+    {
+        unmapChunk(victim.string());
+        if (victim != outFile)
+            fs::remove(victim);
+        // The output has no tombstones; the oldest victim's must not carry over to it
+        fs::remove(TombstoneFile::pathFor(victim));
+        dirtyFiles.erase(victim.string());
+        dirtyFiles.erase(TombstoneFile::pathFor(victim).string());
+    }
+    fs::rename(tmpFile, outFile);
+
+    unordered_set<string> victimFiles;
+    for (const auto &victim : victims)
+        victimFiles.insert(victim.string());
+
+    // Runs into the victims are stale even where they now fall inside the output
+    for (const auto &source : victimSources)
+    {
+        auto &sourceRuns = edgeIndex[source];
+        sourceRuns.erase(remove_if(sourceRuns.begin(), sourceRuns.end(),
+                                   [&](const EdgeRun &run) { return victimFiles.count(run.file) > 0; }),
+                         sourceRuns.end());
+        edgeCache.invalidate(source);
+    }
+    for (size_t i = 0; i < runs.size(); ++i)
+        edgeIndex[runSources[i]].push_back(runs[i]);
+
+    fs::remove(COMPACTION_JOURNAL_PATH);
+
+    printf("reorganizeEdgeGroup: Merged %zu chunk(s) into %s (%zu edges, %zu runs).\n", victims.size(), outFile.string().c_str(), edges.size(), runs.size());
+    fflush(stdout);
+    return true;
+}
+
+// ====================== NODE FOOTERS ======================
+size_t Storage::writeNodeFooters()
+{
+    lock_guard<mutex> pass(compactionPassMutex);
+
+    vector<fs::path> candidates;
+    {
+        lock_guard<recursive_mutex> lock(storageMutex);
+        for (const auto &entry : fs::directory_iterator(NODES_BASE_PATH))
+        {
+            int chunk = chunkNumber(entry.path(), "nodes");
+            // The active chunk still receives appends and is left alone
+            if (chunk >= 0 && chunk != lastNodeChunkIdx)
+                candidates.push_back(entry.path());
+        }
+    }
+
+    // Sealed chunks only change through passes like this one, so no lock is needed to read them
+    size_t written = 0;
+    for (const auto &file : candidates)
+    {
+        if (compactionStopping)
+            break;
+
+        auto mapping = mapChunk(file.string());
+        if (!mapping)
+            continue;
+        ChunkReader reader(*mapping, &dictionaries);
+        NodeFooter current;
+        if (!reader.valid() || current.open(file, reader.header().count))
+            continue;
+
+        vector<pair<uint64_t, uint32_t>> records;
+        records.reserve(reader.header().count);
+        for (size_t i = 0; i < reader.header().count; ++i)
+        {
+            uint32_t offset = static_cast<uint32_t>(reader.tell());
+            NodeView node = reader.readNodeView();
+            if (!reader.good())
+                break;
+            records.emplace_back(hashNodeId(node.id), offset);
+        }
+
+        if (records.size() == reader.header().count && NodeFooter::write(file, records.size(), records))
+        {
+            nodeFooters.invalidate(chunkNumber(file, "nodes"));
+            ++written;
+        }
+    }
+
+    if (written > 0)
+    {
+        printf("writeNodeFooters: Wrote %zu footer(s).\n", written);
+        fflush(stdout);
+    }
+    return written;
+}
+
+// ====================== COMPRESS SEALED CHUNKS ======================
+void Storage::setChunkCompression(bool enabled)
+{
+    chunkCompression = enabled;
+    if (enabled)
+        requestCompaction();
+}
+
+size_t Storage::compressSealedChunks(size_t bytesPerSecond)
+{
+    lock_guard<mutex> pass(compactionPassMutex);
+    if (!chunkCompression)
+        return 0;
+
+    vector<fs::path> candidates;
+    {
+        lock_guard<recursive_mutex> lock(storageMutex);
+        for (const auto &[folder, prefix, active] : {make_tuple(NODES_BASE_PATH, "nodes", lastNodeChunkIdx),
+                                                    make_tuple(EDGES_BASE_PATH, "edges", lastEdgeChunkIdx)})
+        {
+            for (const auto &entry : fs::directory_iterator(folder))
+            {
+                int chunk = chunkNumber(entry.path(), prefix);
+                // The active chunk still receives appends and is left alone
+                if (chunk < 0 || chunk == active)
+                    continue;
+
+                ifstream in(entry.path(), ios::binary);
+                ChunkHeader header;
+                if (header.read(in) && header.format != RecordFormat::V1 && !header.compressed())
+                    candidates.push_back(entry.path());
+            }
+        }
+    }
+
+    size_t compressed = 0;
+    for (const auto &file : candidates)
+    {
+        if (compactionStopping)
+            break;
+        if (compressChunk(file, bytesPerSecond))
+            ++compressed;
+    }
+
+    if (!candidates.empty())
+    {
+        printf("compressSealedChunks: Compressed %zu of %zu sealed chunk(s).\n", compressed, candidates.size());
+        fflush(stdout);
+    }
+    return compressed;
+}
+
+bool Storage::compressChunk(const fs::path &file, size_t bytesPerSecond)
+{
+    int chunk = max(chunkNumber(file, "nodes"), chunkNumber(file, "edges"));
+    fs::path tmpFile = file.parent_path() / ("compress_" + to_string(chunk) + ".tmp");
+
+    // 1. Encode without holding the storage lock; sealed chunks only change through
+    //    compaction passes, and those are serialized with this one
+    uint64_t before;
+    {
+        auto mapping = mapChunk(file.string());
+        if (!mapping)
+            return false;
+        before = mapping->size();
+
+        RateLimiter limiter(bytesPerSecond);
+        limiter.consume(before);
+        if (!writeCompressedChunk(*mapping, tmpFile) || !syncFile(tmpFile))
+        {
+            printf("compressChunk: Write failed for %s\n", tmpFile.string().c_str());
+            fflush(stdout);
+            fs::remove(tmpFile);
+            return false;
+        }
+    }
+
+    // 2. Swap under the lock. Offsets are unchanged, so the indexes and the tombstone
+    //    file keep pointing at the same records.
+    lock_guard<recursive_mutex> lock(storageMutex);
+    unmapChunk(file.string());
+    error_code ec;
+    fs::rename(tmpFile, file, ec);
+    if (ec)
+    {
+        printf("compressChunk: Cannot replace %s: %s\n", file.string().c_str(), ec.message().c_str());
+        fflush(stdout);
+        fs::remove(tmpFile);
+        return false;
+    }
+
+    printf("compressChunk: %s %llu -> %llu bytes.\n", file.string().c_str(),
+           static_cast<unsigned long long>(before), static_cast<unsigned long long>(fs::file_size(file, ec)));
+    fflush(stdout);
+    return true;
+}
+
+// ====================== RECOVERY ======================
+void Storage::recoverCompaction()
+{
+    finishCompactionJournal();
+
+    // Outputs and footers that never got published are simply discarded
+    for (const auto &folder : {NODES_BASE_PATH, EDGES_BASE_PATH})
+    {
+        for (const auto &entry : fs::directory_iterator(folder))
+        {
+            string name = entry.path().filename().string();
+            bool footer = entry.path().stem().extension() == ".ftr";
+            if (entry.path().extension() == ".tmp" && (name.rfind("compact_", 0) == 0 || name.rfind("compress_", 0) == 0 || footer))
+                fs::remove(entry.path());
+        }
+    }
+}
+
+void Storage::finishCompactionJournal()
+{
+    ifstream journal(COMPACTION_JOURNAL_PATH);
+    if (!journal)
+        return;
+
+    fs::path output, staged;
+    vector<fs::path> victims;
+    string kind, path;
+    while (journal >> kind && getline(journal >> ws, path))
+    {
+        if (kind == "output")
+            output = path;
+        else if (kind == "staged")
+            staged = path;
+        else if (kind == "victim")
+            victims.emplace_back(path);
+    }
+    journal.close();
+
+    // An edge reorganization replaces its oldest victim in place. The staged output
+    // was synced before the journal was written, so the swap is always rolled forward.
+    if (!staged.empty())
+    {
+        lock_guard<recursive_mutex> lock(storageMutex);
+        bool swapped = !fs::exists(staged);
+        for (const auto &victim : victims)
+        {
+            if (victim != output)
+                fs::remove(victim);
+            if (!swapped)
+                fs::remove(TombstoneFile::pathFor(victim));
+            dirtyFiles.erase(victim.string());
+            dirtyFiles.erase(TombstoneFile::pathFor(victim).string());
+        }
+        if (!swapped)
+            fs::rename(staged, output);
+        printf("recoverCompaction: Finished interrupted reorganization into %s\n", output.string().c_str());
+        fflush(stdout);
+    }
+    // Once the output is in place its victims are duplicates and must go
+    else if (!output.empty() && fs::exists(output))
+    {
+        lock_guard<recursive_mutex> lock(storageMutex);
+        for (const auto &victim : victims)
+        {
+            fs::remove(victim);
+            fs::remove(TombstoneFile::pathFor(victim));
+            fs::remove(NodeFooter::pathFor(victim));
+            dirtyFiles.erase(victim.string());
+            dirtyFiles.erase(TombstoneFile::pathFor(victim).string());
+        }
+        printf("recoverCompaction: Finished interrupted compaction into %s\n", output.string().c_str());
+        fflush(stdout);
+    }
+    else if (!output.empty())
+    {
+        fs::remove(TombstoneFile::pathFor(output));
+        fs::remove(NodeFooter::pathFor(output));
+    }
+    fs::remove(COMPACTION_JOURNAL_PATH);
+}
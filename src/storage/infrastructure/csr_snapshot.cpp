@@ -0,0 +1,147 @@
+#include "csr_snapshot.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include "write_ahead_log.hpp"
+
+using namespace std;
+using namespace graphdb;
+
+namespace
+{
+    const char CSR_MAGIC[4] = {'G', 'D', 'C', 'S'};
+    const uint32_t CSR_VERSION = 1;
+
+    struct CsrHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t nodeCount;
+        uint64_t edgeCount;
+        uint64_t idBytes;
+    };
+
+    static_assert(sizeof(CsrHeader) == 32, "CSR header must keep its on-disk size");
+
+    uint64_t padded(uint64_t bytes)
+    {
+        return (bytes + 7) & ~uint64_t(7);
+    }
+}
+
+bool CsrSnapshot::open(const fs::path &file)
+{
+    nodes = 0;
+    edges = 0;
+
+    if (!mapping.open(file) || mapping.size() < sizeof(CsrHeader))
+        return false;
+
+    const char *base = mapping.data();
+    CsrHeader header;
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, CSR_MAGIC, sizeof(header.magic)) != 0 || header.version != CSR_VERSION)
+        return false;
+
+    uint64_t expected = sizeof(CsrHeader);
+    uint64_t idOffsetsAt = expected;
+    expected += (header.nodeCount + 1) * sizeof(uint64_t);
+    uint64_t edgeOffsetsAt = expected;
+    expected += (header.nodeCount + 1) * sizeof(uint64_t);
+    uint64_t targetsAt = expected;
+    expected += padded(header.edgeCount * sizeof(uint32_t));
+    uint64_t weightsAt = expected;
+    expected += header.edgeCount * sizeof(double);
+    uint64_t idsAt = expected;
+    expected += header.idBytes;
+    if (expected != mapping.size())
+        return false;
+
+    idOffsets = reinterpret_cast<const uint64_t *>(base + idOffsetsAt);
+    edgeOffsets = reinterpret_cast<const uint64_t *>(base + edgeOffsetsAt);
+    targetArray = reinterpret_cast<const uint32_t *>(base + targetsAt);
+    weightArray = reinterpret_cast<const double *>(base + weightsAt);
+    ids = base + idsAt;
+
+    // Only the two ends are checked; both offset arrays are monotonic by construction
+    if (idOffsets[header.nodeCount] != header.idBytes || edgeOffsets[header.nodeCount] != header.edgeCount)
+        return false;
+
+    nodes = header.nodeCount;
+    edges = header.edgeCount;
+    return true;
+}
+
+string_view CsrSnapshot::id(uint32_t node) const
+{
+    return string_view(ids + idOffsets[node], idOffsets[node + 1] - idOffsets[node]);
+}
+
+int64_t CsrSnapshot::find(string_view nodeId) const
+{
+    uint64_t lo = 0, hi = nodes;
+    while (lo < hi)
+    {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (id(static_cast<uint32_t>(mid)) < nodeId)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo < nodes && id(static_cast<uint32_t>(lo)) == nodeId ? static_cast<int64_t>(lo) : -1;
+}
+
+span<const uint32_t> CsrSnapshot::targets(uint32_t node) const
+{
+    return span<const uint32_t>(targetArray + edgeOffsets[node], edgeOffsets[node + 1] - edgeOffsets[node]);
+}
+
+span<const double> CsrSnapshot::weights(uint32_t node) const
+{
+    return span<const double>(weightArray + edgeOffsets[node], edgeOffsets[node + 1] - edgeOffsets[node]);
+}
+
+bool CsrSnapshot::write(const fs::path &file, const vector<string> &nodeIds, const vector<uint64_t> &offsets,
+                        const vector<uint32_t> &targets, const vector<double> &weights)
+{
+    CsrHeader header{};
+    memcpy(header.magic, CSR_MAGIC, sizeof(header.magic));
+    header.version = CSR_VERSION;
+    header.nodeCount = nodeIds.size();
+    header.edgeCount = targets.size();
+
+    vector<uint64_t> idOffsets;
+    idOffsets.reserve(nodeIds.size() + 1);
+    idOffsets.push_back(0);
+    for (const auto &id : nodeIds)
+        idOffsets.push_back(idOffsets.back() + id.size());
+    header.idBytes = idOffsets.back();
+
+    fs::path tmp = file;
+    tmp += ".tmp";
+    {
+        ofstream out(tmp, ios::binary | ios::trunc);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(idOffsets.data()), idOffsets.size() * sizeof(uint64_t));
+        out.write(reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(uint64_t));
+        out.write(reinterpret_cast<const char *>(targets.data()), targets.size() * sizeof(uint32_t));
+
+        static const char zeros[8] = {};
+        out.write(zeros, padded(targets.size() * sizeof(uint32_t)) - targets.size() * sizeof(uint32_t));
+
+        out.write(reinterpret_cast<const char *>(weights.data()), weights.size() * sizeof(double));
+        for (const auto &id : nodeIds)
+            out.write(id.data(), id.size());
+
+        out.close();
+        if (out.fail() || !syncFile(tmp))
+        {
+            fs::remove(tmp);
+            return false;
+        }
+    }
+
+    error_code ec;
+    fs::rename(tmp, file, ec);
+    return !ec;
+}
@@ -0,0 +1,134 @@
+#include "cuckoo_filter.hpp"
+#include <utility>
+
+using namespace std;
+using namespace graphdb;
+
+void CuckooFilter::reset(size_t capacity)
+{
+    // Stay around 90% occupancy at the requested capacity, where inserts rarely run out of kicks
+    size_t wanted = capacity * 10 / 9 / SLOTS_PER_BUCKET + 1;
+    size_t buckets = 1;
+    while (buckets < wanted)
+        buckets <<= 1;
+
+    slots.assign(buckets * SLOTS_PER_BUCKET, 0);
+    bucketMask = buckets - 1;
+    victim = 0;
+    victimBucket = 0;
+}
+
+CuckooFilter::Probe CuckooFilter::probe(uint64_t keyHash) const
+{
+    // 0 marks an empty slot
+    uint16_t fingerprint = static_cast<uint16_t>(keyHash >> 48);
+    if (fingerprint == 0)
+        fingerprint = 1;
+
+    size_t first = static_cast<size_t>(keyHash) & bucketMask;
+    return {fingerprint, first, alternate(first, fingerprint)};
+}
+
+size_t CuckooFilter::alternate(size_t bucket, uint16_t fingerprint) const
+{
+    // XOR with a hash of the fingerprint is its own inverse, so either bucket leads to the other
+    return (bucket ^ (static_cast<size_t>(fingerprint) * 0x5BD1E995u)) & bucketMask;
+}
+
+bool CuckooFilter::bucketHas(size_t bucket, uint16_t fingerprint) const
+{
+    const uint16_t *slot = &slots[bucket * SLOTS_PER_BUCKET];
+    for (size_t i = 0; i < SLOTS_PER_BUCKET; ++i)
+    {
+        if (slot[i] == fingerprint)
+            return true;
+    }
+    return false;
+}
+
+bool CuckooFilter::place(size_t bucket, uint16_t fingerprint)
+{
+    uint16_t *slot = &slots[bucket * SLOTS_PER_BUCKET];
+    for (size_t i = 0; i < SLOTS_PER_BUCKET; ++i)
+    {
+        if (slot[i] == 0)
+        {
+            slot[i] = fingerprint;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CuckooFilter::insert(uint64_t keyHash)
+{
+    if (slots.empty())
+        reset(0);
+    if (victim != 0)
+        return false;
+
+    Probe p = probe(keyHash);
+    if (place(p.first, p.fingerprint) || place(p.second, p.fingerprint))
+        return true;
+
+    // Both buckets are full: evict residents to their other bucket until one lands
+    size_t bucket = (p.fingerprint & 1) ? p.first : p.second;
+    uint16_t fingerprint = p.fingerprint;
+    for (int kick = 0; kick < MAX_KICKS; ++kick)
+    {
+        size_t slot = bucket * SLOTS_PER_BUCKET + static_cast<size_t>(kick) % SLOTS_PER_BUCKET;
+        swap(fingerprint, slots[slot]);
+        bucket = alternate(bucket, fingerprint);
+        if (place(bucket, fingerprint))
+            return true;
+    }
+
+    // The key itself is stored by now; only the last evicted fingerprint is homeless
+    victim = fingerprint;
+    victimBucket = bucket;
+    return true;
+}
+
+bool CuckooFilter::mayContain(uint64_t keyHash) const
+{
+    if (slots.empty())
+        return false;
+
+    Probe p = probe(keyHash);
+    if (bucketHas(p.first, p.fingerprint) || bucketHas(p.second, p.fingerprint))
+        return true;
+    return victim == p.fingerprint && (victimBucket == p.first || victimBucket == p.second);
+}
+
+void CuckooFilter::erase(uint64_t keyHash)
+{
+    if (slots.empty())
+        return;
+
+    Probe p = probe(keyHash);
+    bool erased = false;
+    if (victim == p.fingerprint && (victimBucket == p.first || victimBucket == p.second))
+    {
+        victim = 0;
+        return;
+    }
+    for (size_t bucket : {p.first, p.second})
+    {
+        uint16_t *slot = &slots[bucket * SLOTS_PER_BUCKET];
+        for (size_t i = 0; i < SLOTS_PER_BUCKET && !erased; ++i)
+        {
+            if (slot[i] == p.fingerprint)
+            {
+                slot[i] = 0;
+                erased = true;
+            }
+        }
+        if (erased)
+            break;
+    }
+
+    // The freed slot may be where the homeless fingerprint belongs
+    if (erased && victim != 0 &&
+        (place(victimBucket, victim) || place(alternate(victimBucket, victim), victim)))
+        victim = 0;
+}
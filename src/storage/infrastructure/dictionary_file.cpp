@@ -0,0 +1,100 @@
+#include "dictionary_file.hpp"
+#include "write_ahead_log.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+using namespace std;
+using namespace graphdb;
+
+namespace
+{
+    const uint32_t DICTIONARY_VERSION = 1;
+    const size_t DICTIONARY_HEADER_SIZE = 4 + sizeof(DICTIONARY_VERSION);
+}
+
+bool DictionaryFile::load(const fs::path &file, const char (&magic)[4], const function<void(const string &)> &add)
+{
+    ifstream in(file, ios::binary | ios::ate);
+    if (!in)
+        return !fs::exists(file);
+
+    string buf(static_cast<size_t>(in.tellg()), '\0');
+    in.seekg(0);
+    if (!in.read(buf.data(), buf.size()))
+        return false;
+    in.close();
+
+    // A crash before the header reached the disk leaves nothing worth keeping
+    if (buf.size() < DICTIONARY_HEADER_SIZE)
+    {
+        error_code ec;
+        fs::remove(file, ec);
+        return true;
+    }
+
+    uint32_t version;
+    memcpy(&version, buf.data() + sizeof(magic), sizeof(version));
+    if (memcmp(buf.data(), magic, sizeof(magic)) != 0 || version != DICTIONARY_VERSION)
+        return false;
+
+    size_t pos = DICTIONARY_HEADER_SIZE;
+    while (buf.size() - pos >= sizeof(uint32_t))
+    {
+        uint32_t length;
+        memcpy(&length, buf.data() + pos, sizeof(length));
+        if (buf.size() - pos - sizeof(length) < length)
+            break;
+
+        add(buf.substr(pos + sizeof(length), length));
+        pos += sizeof(length) + length;
+    }
+
+    // Entries of an append that never completed were not referenced by any record yet
+    if (pos != buf.size())
+    {
+        printf("DictionaryFile: Dropping %zu bytes of torn tail from %s\n", buf.size() - pos, file.string().c_str());
+        fflush(stdout);
+        error_code ec;
+        fs::resize_file(file, pos, ec);
+        if (ec)
+            return false;
+    }
+    return true;
+}
+
+bool DictionaryFile::append(const fs::path &file, const char (&magic)[4], const vector<string> &entries)
+{
+    if (entries.empty())
+        return true;
+
+    error_code ec;
+    uint64_t before = fs::exists(file, ec) ? fs::file_size(file, ec) : 0;
+    bool fresh = ec || before == 0;
+
+    string buf;
+    if (fresh)
+    {
+        buf.append(magic, sizeof(magic));
+        buf.append(reinterpret_cast<const char *>(&DICTIONARY_VERSION), sizeof(DICTIONARY_VERSION));
+    }
+    for (const auto &entry : entries)
+    {
+        uint32_t length = static_cast<uint32_t>(entry.size());
+        buf.append(reinterpret_cast<const char *>(&length), sizeof(length));
+        buf.append(entry);
+    }
+
+    ofstream out(file, ios::binary | ios::app);
+    out.write(buf.data(), buf.size());
+    out.close();
+    if (!out.fail() && syncFile(file))
+        return true;
+
+    // Later appends must not land behind a partial entry
+    if (!fresh)
+        fs::resize_file(file, before, ec);
+    else
+        fs::remove(file, ec);
+    return false;
+}
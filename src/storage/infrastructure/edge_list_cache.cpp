@@ -0,0 +1,97 @@
+#include "edge_list_cache.hpp"
+
+using namespace std;
+using namespace graphdb;
+
+EdgeListCache::EdgeListCache(size_t budgetBytes) : budget(budgetBytes) {}
+
+size_t EdgeListCache::weigh(const Edge &edge)
+{
+    size_t total = sizeof(Edge) + edge.from.size() + edge.to.size();
+    for (const auto &[key, value] : edge.properties)
+        total += sizeof(PropertyValue) + key.size() + value.estimateSize() + 32;
+    return total;
+}
+
+const vector<Edge> *EdgeListCache::get(const string &from)
+{
+    auto it = entries.find(from);
+    if (it == entries.end())
+    {
+        ++misses;
+        return nullptr;
+    }
+
+    ++hits;
+    lru.splice(lru.begin(), lru, it->second);
+    return &it->second->edges;
+}
+
+void EdgeListCache::put(const string &from, vector<Edge> edges)
+{
+    invalidate(from);
+
+    size_t total = sizeof(Entry) + from.size();
+    for (const auto &edge : edges)
+        total += weigh(edge);
+    // A list that would take over the whole cache is cheaper to decode each time
+    if (total > budget / 4)
+        return;
+
+    lru.push_front({from, move(edges), total});
+    entries[from] = lru.begin();
+    bytes += total;
+    evict();
+}
+
+void EdgeListCache::append(const string &from, const Edge &edge)
+{
+    auto it = entries.find(from);
+    if (it == entries.end())
+        return;
+
+    size_t added = weigh(edge);
+    if (it->second->bytes + added > budget / 4)
+    {
+        invalidate(from);
+        return;
+    }
+
+    it->second->edges.push_back(edge);
+    it->second->bytes += added;
+    bytes += added;
+    evict();
+}
+
+void EdgeListCache::invalidate(const string &from)
+{
+    auto it = entries.find(from);
+    if (it == entries.end())
+        return;
+
+    bytes -= it->second->bytes;
+    lru.erase(it->second);
+    entries.erase(it);
+}
+
+void EdgeListCache::clear()
+{
+    lru.clear();
+    entries.clear();
+    bytes = 0;
+}
+
+EdgeListCache::Stats EdgeListCache::stats() const
+{
+    return {hits, misses, entries.size(), bytes};
+}
+
+void EdgeListCache::evict()
+{
+    while (bytes > budget && !lru.empty())
+    {
+        bytes -= lru.back().bytes;
+        entries.erase(lru.back().from);
+        lru.pop_back();
+    }
+}
@@ -0,0 +1,265 @@
+#include "index_file.hpp"
+#include "tombstone_file.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+using namespace std;
+using namespace graphdb;
+
+namespace
+{
+    const char NODE_INDEX_MAGIC[4] = {'G', 'D', 'N', 'X'};
+    const uint32_t NODE_INDEX_VERSION = 3;
+    const char EDGE_INDEX_MAGIC[4] = {'G', 'D', 'E', 'X'};
+    const uint32_t EDGE_INDEX_VERSION = 3;
+
+    struct EdgeIndexHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t chunkCount;
+        uint64_t sourceCount;
+        uint64_t refCount;
+        uint64_t idBytes;
+    };
+
+    struct ChunkEntry
+    {
+        uint32_t chunk;
+        uint32_t reserved;
+        uint64_t size;
+        int64_t mtime;
+        uint64_t tombstoneSize;
+    };
+
+    static_assert(sizeof(EdgeIndexHeader) == 40 && sizeof(ChunkEntry) == 32 && sizeof(EdgeRef) == 24,
+                  "edge index file sections must keep their on-disk size");
+    static_assert(sizeof(NodeIndexEntry) == 16, "node index entries must keep their on-disk size");
+
+    // Chunks modified this close to the moment the index file is written may still
+    // change within the same mtime tick, so their stamps are never trusted.
+    const auto RACY_WINDOW = chrono::seconds(2);
+
+    template <typename T>
+    void put(string &buf, const T &value)
+    {
+        buf.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    bool take(const string &buf, size_t &pos, T &value)
+    {
+        if (buf.size() - pos < sizeof(value))
+            return false;
+        memcpy(&value, buf.data() + pos, sizeof(value));
+        pos += sizeof(value);
+        return true;
+    }
+
+    // Stamp as it should be recorded in an index file written now
+    ChunkStamp recordedStamp(const ChunkStamp &stamp, int64_t racyFrom)
+    {
+        // A zeroed stamp never matches a real file, forcing a rescan on next open
+        return stamp.mtime >= racyFrom ? ChunkStamp{} : stamp;
+    }
+
+    bool readWhole(const fs::path &file, string &buf)
+    {
+        ifstream in(file, ios::binary | ios::ate);
+        if (!in)
+            return false;
+        buf.resize(static_cast<size_t>(in.tellg()));
+        in.seekg(0);
+        return static_cast<bool>(in.read(buf.data(), buf.size()));
+    }
+
+    // Write to a temporary file first so a crash never leaves a half-written index behind
+    bool writeAtomically(const fs::path &file, const string &buf)
+    {
+        fs::path tmp = file;
+        tmp += ".tmp";
+        {
+            ofstream out(tmp, ios::binary | ios::trunc);
+            if (!out.write(buf.data(), buf.size()))
+                return false;
+        }
+        error_code ec;
+        fs::rename(tmp, file, ec);
+        return !ec;
+    }
+}
+
+ChunkStamp ChunkStamp::of(const fs::path &file)
+{
+    ChunkStamp stamp;
+    error_code ec;
+    stamp.size = fs::file_size(file, ec);
+    if (ec)
+        return {};
+    stamp.mtime = fs::last_write_time(file, ec).time_since_epoch().count();
+
+    // Deletes only touch the tombstone file, which never shrinks while the chunk exists
+    uint64_t tombstoneSize = fs::file_size(TombstoneFile::pathFor(file), ec);
+    stamp.tombstoneSize = ec ? 0 : tombstoneSize;
+    return stamp;
+}
+
+bool NodeIndexFile::read(const fs::path &file)
+{
+    chunks.clear();
+    entries.clear();
+
+    string buf;
+    if (!readWhole(file, buf))
+        return false;
+
+    size_t pos = 0;
+    char magic[4];
+    uint32_t version;
+    uint64_t chunkCount;
+    if (!take(buf, pos, magic) || memcmp(magic, NODE_INDEX_MAGIC, sizeof(magic)) != 0 ||
+        !take(buf, pos, version) || version != NODE_INDEX_VERSION ||
+        !take(buf, pos, chunkCount))
+        return false;
+
+    for (uint64_t i = 0; i < chunkCount; ++i)
+    {
+        uint32_t chunk;
+        ChunkStamp stamp;
+        if (!take(buf, pos, chunk) || !take(buf, pos, stamp.size) || !take(buf, pos, stamp.mtime) ||
+            !take(buf, pos, stamp.tombstoneSize))
+            return false;
+        chunks[chunk] = stamp;
+    }
+
+    uint64_t entryCount;
+    if (!take(buf, pos, entryCount) || (buf.size() - pos) / sizeof(NodeIndexEntry) != entryCount ||
+        (buf.size() - pos) % sizeof(NodeIndexEntry) != 0)
+        return false;
+
+    entries.resize(entryCount);
+    memcpy(entries.data(), buf.data() + pos, entryCount * sizeof(NodeIndexEntry));
+    return true;
+}
+
+bool NodeIndexFile::write(const fs::path &file) const
+{
+    auto racyFrom = (fs::file_time_type::clock::now() - RACY_WINDOW).time_since_epoch().count();
+
+    string buf;
+    buf.append(NODE_INDEX_MAGIC, sizeof(NODE_INDEX_MAGIC));
+    put(buf, NODE_INDEX_VERSION);
+    put(buf, static_cast<uint64_t>(chunks.size()));
+    for (const auto &[chunk, stamp] : chunks)
+    {
+        ChunkStamp recorded = recordedStamp(stamp, racyFrom);
+        put(buf, chunk);
+        put(buf, recorded.size);
+        put(buf, recorded.mtime);
+        put(buf, recorded.tombstoneSize);
+    }
+
+    put(buf, static_cast<uint64_t>(entries.size()));
+    buf.append(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(NodeIndexEntry));
+
+    return writeAtomically(file, buf);
+}
+
+bool EdgeIndexFile::open(const fs::path &file)
+{
+    chunks.clear();
+    sources = nullptr;
+    sourceCount = 0;
+
+    if (!mapping.open(file) || mapping.size() < sizeof(EdgeIndexHeader))
+        return false;
+
+    const char *base = mapping.data();
+    EdgeIndexHeader header;
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, EDGE_INDEX_MAGIC, sizeof(header.magic)) != 0 || header.version != EDGE_INDEX_VERSION)
+        return false;
+
+    // Every section size has to add up to exactly the mapped length
+    uint64_t expected = sizeof(EdgeIndexHeader);
+    uint64_t chunksAt = expected;
+    expected += header.chunkCount * sizeof(ChunkEntry);
+    uint64_t sourcesAt = expected;
+    expected += header.sourceCount * sizeof(SourceEntry);
+    uint64_t refsAt = expected;
+    expected += header.refCount * sizeof(EdgeRef);
+    uint64_t idsAt = expected;
+    expected += header.idBytes;
+    if (expected != mapping.size())
+        return false;
+
+    auto chunkTable = reinterpret_cast<const ChunkEntry *>(base + chunksAt);
+    for (uint64_t i = 0; i < header.chunkCount; ++i)
+        chunks[chunkTable[i].chunk] = {chunkTable[i].size, chunkTable[i].mtime, chunkTable[i].tombstoneSize};
+
+    sources = reinterpret_cast<const SourceEntry *>(base + sourcesAt);
+    refs = reinterpret_cast<const EdgeRef *>(base + refsAt);
+    ids = base + idsAt;
+
+    for (uint64_t i = 0; i < header.sourceCount; ++i)
+    {
+        if (sources[i].idOffset + sources[i].idLen > header.idBytes ||
+            sources[i].firstRef + sources[i].refCount > header.refCount)
+        {
+            chunks.clear();
+            return false;
+        }
+    }
+    sourceCount = header.sourceCount;
+    return true;
+}
+
+bool EdgeIndexFile::write(const fs::path &file, const unordered_map<uint32_t, ChunkStamp> &chunks,
+                          vector<pair<string, vector<EdgeRef>>> sources)
+{
+    auto racyFrom = (fs::file_time_type::clock::now() - RACY_WINDOW).time_since_epoch().count();
+
+    sort(sources.begin(), sources.end(),
+         [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    EdgeIndexHeader header{};
+    memcpy(header.magic, EDGE_INDEX_MAGIC, sizeof(header.magic));
+    header.version = EDGE_INDEX_VERSION;
+    header.chunkCount = chunks.size();
+    header.sourceCount = sources.size();
+    for (const auto &[id, sourceRefs] : sources)
+    {
+        header.refCount += sourceRefs.size();
+        header.idBytes += id.size();
+    }
+
+    string buf;
+    buf.reserve(sizeof(header) + header.chunkCount * sizeof(ChunkEntry) + header.sourceCount * sizeof(SourceEntry) +
+                header.refCount * sizeof(EdgeRef) + header.idBytes);
+    put(buf, header);
+
+    for (const auto &[chunk, stamp] : chunks)
+    {
+        ChunkStamp recorded = recordedStamp(stamp, racyFrom);
+        put(buf, ChunkEntry{chunk, 0, recorded.size, recorded.mtime, recorded.tombstoneSize});
+    }
+
+    uint64_t idOffset = 0;
+    uint64_t firstRef = 0;
+    for (const auto &[id, sourceRefs] : sources)
+    {
+        put(buf, SourceEntry{idOffset, static_cast<uint32_t>(id.size()), 0, firstRef, sourceRefs.size()});
+        idOffset += id.size();
+        firstRef += sourceRefs.size();
+    }
+
+    for (const auto &source : sources)
+        buf.append(reinterpret_cast<const char *>(source.second.data()), source.second.size() * sizeof(EdgeRef));
+
+    for (const auto &source : sources)
+        buf.append(source.first);
+
+    return writeAtomically(file, buf);
+}
@@ -0,0 +1,171 @@
+#include "mapped_file.hpp"
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace graphdb;
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const fs::path &file)
+{
+    close();
+
+    HANDLE handle = CreateFileW(file.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(handle, &fileSize))
+    {
+        CloseHandle(handle);
+        return false;
+    }
+
+    fileHandle = handle;
+    length = static_cast<size_t>(fileSize.QuadPart);
+    opened = true;
+
+    // Zero-length files cannot be mapped, they are simply open and empty
+    if (length == 0)
+        return true;
+
+    mappingHandle = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle)
+    {
+        close();
+        return false;
+    }
+
+    ptr = static_cast<const char *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (!ptr)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (ptr)
+        UnmapViewOfFile(ptr);
+    if (mappingHandle)
+        CloseHandle(mappingHandle);
+    if (fileHandle)
+        CloseHandle(fileHandle);
+
+    ptr = nullptr;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+    length = 0;
+    opened = false;
+}
+
+#else
+
+bool MappedFile::open(const fs::path &file)
+{
+    close();
+
+    int handle = ::open(file.c_str(), O_RDONLY);
+    if (handle < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(handle, &st) != 0)
+    {
+        ::close(handle);
+        return false;
+    }
+
+    fd = handle;
+    length = static_cast<size_t>(st.st_size);
+    opened = true;
+
+    // Zero-length files cannot be mapped, they are simply open and empty
+    if (length == 0)
+        return true;
+
+    void *mapping = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        close();
+        return false;
+    }
+    ptr = static_cast<const char *>(mapping);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (ptr)
+        munmap(const_cast<char *>(ptr), length);
+    if (fd >= 0)
+        ::close(fd);
+
+    ptr = nullptr;
+    fd = -1;
+    length = 0;
+    opened = false;
+}
+
+#endif
+
+void MappedFile::prefetch(size_t offset, size_t count) const
+{
+    if (!ptr || offset >= length)
+        return;
+    count = min(count, length - offset);
+
+#ifndef _WIN32
+    // madvise wants a page-aligned start
+    static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t start = offset - offset % pageSize;
+    madvise(const_cast<char *>(ptr) + start, offset + count - start, MADV_WILLNEED);
+#endif
+}
+
+MemoryStreamBuf::MemoryStreamBuf(const char *data, size_t size)
+{
+    char *begin = const_cast<char *>(data);
+    setg(begin, begin, begin + size);
+}
+
+MemoryStreamBuf::pos_type MemoryStreamBuf::seekoff(off_type off, ios_base::seekdir dir, ios_base::openmode which)
+{
+    if (!(which & ios_base::in))
+        return pos_type(off_type(-1));
+
+    off_type base = 0;
+    if (dir == ios_base::cur)
+        base = gptr() - eback();
+    else if (dir == ios_base::end)
+        base = egptr() - eback();
+
+    off_type target = base + off;
+    if (target < 0 || target > egptr() - eback())
+        return pos_type(off_type(-1));
+
+    setg(eback(), eback() + target, egptr());
+    return pos_type(target);
+}
+
+MemoryStreamBuf::pos_type MemoryStreamBuf::seekpos(pos_type pos, ios_base::openmode which)
+{
+    return seekoff(off_type(pos), ios_base::beg, which);
+}
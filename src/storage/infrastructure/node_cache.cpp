@@ -0,0 +1,241 @@
+#include "node_cache.hpp"
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+using namespace std;
+using namespace graphdb;
+
+// ====================== FREQUENCY SKETCH ======================
+NodeCache::FrequencySketch::FrequencySketch(size_t width)
+{
+    size_t counters = 16;
+    while (counters < width)
+        counters <<= 1;
+
+    // 16 four-bit counters per word
+    table.assign(ROWS * counters / 16, 0);
+    mask = counters - 1;
+    sampleSize = counters * 10;
+}
+
+size_t NodeCache::FrequencySketch::counterIndex(uint64_t hash, size_t row) const
+{
+    uint64_t h = hash + row * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 32;
+    h *= 0xD6E8FEB86659FD93ull;
+    h ^= h >> 32;
+    return row * (mask + 1) + (static_cast<size_t>(h) & mask);
+}
+
+void NodeCache::FrequencySketch::increment(uint64_t hash)
+{
+    bool added = false;
+    for (size_t row = 0; row < ROWS; ++row)
+    {
+        size_t index = counterIndex(hash, row);
+        uint64_t &word = table[index / 16];
+        unsigned shift = static_cast<unsigned>(index % 16) * 4;
+        if (((word >> shift) & 0xF) < 0xF)
+        {
+            word += uint64_t(1) << shift;
+            added = true;
+        }
+    }
+
+    // Aging: halve every counter, so popularity has to be earned again
+    if (added && ++additions >= sampleSize)
+    {
+        for (uint64_t &word : table)
+            word = (word >> 1) & 0x7777777777777777ull;
+        additions /= 2;
+    }
+}
+
+uint32_t NodeCache::FrequencySketch::frequency(uint64_t hash) const
+{
+    uint32_t lowest = 0xF;
+    for (size_t row = 0; row < ROWS; ++row)
+    {
+        size_t index = counterIndex(hash, row);
+        unsigned shift = static_cast<unsigned>(index % 16) * 4;
+        lowest = min(lowest, static_cast<uint32_t>((table[index / 16] >> shift) & 0xF));
+    }
+    return lowest;
+}
+
+// ====================== NODE CACHE ======================
+NodeCache::NodeCache(size_t budgetBytes)
+    : windowBudget(max<size_t>(budgetBytes / 100, 1)),
+      mainBudget(budgetBytes - min(budgetBytes, max<size_t>(budgetBytes / 100, 1))),
+      protectedBudget(mainBudget / 5 * 4),
+      // Roughly one counter per cached node of a few hundred bytes
+      sketch(max<size_t>(budgetBytes / 256, 64))
+{
+}
+
+size_t NodeCache::weigh(const Node &node)
+{
+    // Node, map node and list node overheads are rough but keep small nodes from looking free
+    size_t bytes = sizeof(Entry) + 2 * node.id.size() + 64;
+    for (const auto &[key, value] : node.properties)
+        bytes += sizeof(PropertyValue) + key.size() + value.estimateSize() + 32;
+    return bytes;
+}
+
+uint64_t NodeCache::hashId(const string &id)
+{
+    return hash<string>{}(id);
+}
+
+NodeCache::Lru &NodeCache::lruOf(Segment segment)
+{
+    switch (segment)
+    {
+    case Segment::Window:
+        return window;
+    case Segment::Probation:
+        return probation;
+    default:
+        return protectedLru;
+    }
+}
+
+size_t &NodeCache::bytesOf(Segment segment)
+{
+    switch (segment)
+    {
+    case Segment::Window:
+        return windowBytes;
+    case Segment::Probation:
+        return probationBytes;
+    default:
+        return protectedBytes;
+    }
+}
+
+void NodeCache::moveTo(Lru::iterator it, Segment segment)
+{
+    bytesOf(it->segment) -= it->bytes;
+    bytesOf(segment) += it->bytes;
+    // Splicing keeps the iterator stored in entries valid
+    lruOf(segment).splice(lruOf(segment).begin(), lruOf(it->segment), it);
+    it->segment = segment;
+}
+
+void NodeCache::erase(Lru::iterator it)
+{
+    bytesOf(it->segment) -= it->bytes;
+    entries.erase(it->node.id);
+    lruOf(it->segment).erase(it);
+}
+
+const Node *NodeCache::get(const string &id)
+{
+    sketch.increment(hashId(id));
+
+    auto found = entries.find(id);
+    if (found == entries.end())
+        return nullptr;
+
+    Lru::iterator it = found->second;
+    if (it->segment == Segment::Probation)
+    {
+        // A second hit while on probation earns a place in the protected segment
+        moveTo(it, Segment::Protected);
+        demoteProtected();
+    }
+    else
+    {
+        moveTo(it, it->segment);
+    }
+    return &it->node;
+}
+
+void NodeCache::put(const Node &node)
+{
+    invalidate(node.id);
+
+    size_t bytes = weigh(node);
+    if (bytes > mainBudget)
+        return;
+
+    window.push_front({node, bytes, Segment::Window});
+    windowBytes += bytes;
+    entries[node.id] = window.begin();
+    evictWindow();
+}
+
+void NodeCache::invalidate(const string &id)
+{
+    auto found = entries.find(id);
+    if (found != entries.end())
+        erase(found->second);
+}
+
+void NodeCache::clear()
+{
+    window.clear();
+    probation.clear();
+    protectedLru.clear();
+    entries.clear();
+    windowBytes = probationBytes = protectedBytes = 0;
+}
+
+void NodeCache::evictWindow()
+{
+    while (windowBytes > windowBudget && !window.empty())
+    {
+        Lru::iterator candidate = prev(window.end());
+        uint32_t candidateFrequency = sketch.frequency(hashId(candidate->node.id));
+
+        // Make room in the main segments only by evicting entries seen less often than the
+        // candidate. Every victim it would take is compared before any is evicted, so a
+        // rejected candidate leaves the main segments as they were.
+        vector<Lru::iterator> victims;
+        size_t needed = probationBytes + protectedBytes + candidate->bytes;
+        bool admitted = true;
+        Lru *segment = &probation;
+        Lru::iterator next = probation.end();
+        while (needed > mainBudget)
+        {
+            if (next == segment->begin())
+            {
+                if (segment == &protectedLru)
+                {
+                    admitted = false;
+                    break;
+                }
+                segment = &protectedLru;
+                next = protectedLru.end();
+                continue;
+            }
+
+            --next;
+            if (sketch.frequency(hashId(next->node.id)) >= candidateFrequency)
+            {
+                admitted = false;
+                break;
+            }
+            victims.push_back(next);
+            needed -= next->bytes;
+        }
+
+        if (admitted)
+        {
+            for (Lru::iterator victim : victims)
+                erase(victim);
+            moveTo(candidate, Segment::Probation);
+        }
+        else
+        {
+            erase(candidate);
+        }
+    }
+}
+
+void NodeCache::demoteProtected()
+{
+    while (protectedBytes > protectedBudget && protectedLru.size() > 1)
+        moveTo(prev(protectedLru.end()), Segment::Probation);
+}
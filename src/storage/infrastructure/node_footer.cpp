@@ -0,0 +1,207 @@
+#include "node_footer.hpp"
+#include "write_ahead_log.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+using namespace std;
+using namespace graphdb;
+
+namespace
+{
+    const char FOOTER_MAGIC[4] = {'G', 'D', 'N', 'F'};
+    // v1 footers also carried a copy of every id
+    const uint32_t FOOTER_VERSION = 2;
+    const uint64_t BLOOM_BITS_PER_ENTRY = 10;
+    const uint32_t BLOOM_HASHES = 7;
+
+    // Followed by the hashes (u64 each), the bloom words and the offsets (u32 each),
+    // so every section stays naturally aligned in the mapping
+    struct FooterHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t recordCount;
+        uint64_t entryCount;
+        uint64_t bloomWords;
+        uint32_t bloomHashes;
+        uint32_t reserved;
+    };
+
+    static_assert(sizeof(FooterHeader) == 40, "footer header must keep its on-disk size");
+
+    // Double hashing: probe i lands on h1 + i * h2
+    pair<uint64_t, uint64_t> bloomProbe(uint64_t hash)
+    {
+        uint64_t h2 = ((hash >> 33) | (hash << 31)) * 0x9E3779B97F4A7C15ull;
+        return {hash, h2 | 1};
+    }
+}
+
+fs::path NodeFooter::pathFor(const fs::path &chunkFile)
+{
+    fs::path file = chunkFile;
+    file.replace_extension(".ftr");
+    return file;
+}
+
+bool NodeFooter::write(const fs::path &chunkFile, uint64_t recordCount, const vector<pair<uint64_t, uint32_t>> &records)
+{
+    vector<pair<uint64_t, uint32_t>> sorted(records);
+    sort(sorted.begin(), sorted.end());
+
+    FooterHeader header{};
+    memcpy(header.magic, FOOTER_MAGIC, sizeof(header.magic));
+    header.version = FOOTER_VERSION;
+    header.recordCount = recordCount;
+    header.entryCount = sorted.size();
+    header.bloomWords = max<uint64_t>(1, (sorted.size() * BLOOM_BITS_PER_ENTRY + 63) / 64);
+    header.bloomHashes = BLOOM_HASHES;
+
+    vector<uint64_t> hashes;
+    vector<uint32_t> offsets;
+    hashes.reserve(sorted.size());
+    offsets.reserve(sorted.size());
+    vector<uint64_t> bloom(header.bloomWords, 0);
+    uint64_t bits = header.bloomWords * 64;
+    for (const auto &[hash, offset] : sorted)
+    {
+        hashes.push_back(hash);
+        offsets.push_back(offset);
+        auto [h1, h2] = bloomProbe(hash);
+        for (uint32_t i = 0; i < BLOOM_HASHES; ++i)
+        {
+            uint64_t bit = (h1 + i * h2) % bits;
+            bloom[bit / 64] |= uint64_t(1) << (bit % 64);
+        }
+    }
+
+    fs::path file = pathFor(chunkFile);
+    fs::path tmp = file;
+    tmp += ".tmp";
+    {
+        ofstream out(tmp, ios::binary | ios::trunc);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(hashes.data()), hashes.size() * sizeof(uint64_t));
+        out.write(reinterpret_cast<const char *>(bloom.data()), bloom.size() * sizeof(uint64_t));
+        out.write(reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(uint32_t));
+        out.close();
+        if (out.fail() || !syncFile(tmp))
+        {
+            fs::remove(tmp);
+            return false;
+        }
+    }
+
+    error_code ec;
+    fs::rename(tmp, file, ec);
+    return !ec;
+}
+
+bool NodeFooter::open(const fs::path &chunkFile, uint64_t recordCount)
+{
+    entryCount = 0;
+    if (!mapping.open(pathFor(chunkFile)) || mapping.size() < sizeof(FooterHeader))
+        return false;
+
+    FooterHeader header;
+    memcpy(&header, mapping.data(), sizeof(header));
+    if (memcmp(header.magic, FOOTER_MAGIC, sizeof(header.magic)) != 0 || header.version != FOOTER_VERSION ||
+        header.recordCount != recordCount || header.bloomWords == 0 || header.bloomHashes == 0)
+        return false;
+
+    uint64_t expected = sizeof(FooterHeader) + header.entryCount * (sizeof(uint64_t) + sizeof(uint32_t)) + header.bloomWords * sizeof(uint64_t);
+    if (expected != mapping.size())
+        return false;
+
+    hashes = reinterpret_cast<const uint64_t *>(mapping.data() + sizeof(FooterHeader));
+    bloom = hashes + header.entryCount;
+    offsets = reinterpret_cast<const uint32_t *>(bloom + header.bloomWords);
+
+    entryCount = header.entryCount;
+    bloomBits = header.bloomWords * 64;
+    bloomHashes = header.bloomHashes;
+    return true;
+}
+
+bool NodeFooter::mayContain(uint64_t hash) const
+{
+    if (entryCount == 0)
+        return false;
+
+    auto [h1, h2] = bloomProbe(hash);
+    for (uint32_t i = 0; i < bloomHashes; ++i)
+    {
+        uint64_t bit = (h1 + i * h2) % bloomBits;
+        if (!(bloom[bit / 64] & (uint64_t(1) << (bit % 64))))
+            return false;
+    }
+    return true;
+}
+
+vector<uint32_t> NodeFooter::find(uint64_t hash) const
+{
+    vector<uint32_t> found;
+    if (!mayContain(hash))
+        return found;
+
+    const uint64_t *first = lower_bound(hashes, hashes + entryCount, hash);
+    for (const uint64_t *it = first; it != hashes + entryCount && *it == hash; ++it)
+        found.push_back(offsets[it - hashes]);
+    return found;
+}
+
+NodeFooterCache::NodeFooterCache(size_t capacity)
+    : capacity(capacity)
+{
+}
+
+shared_ptr<const NodeFooter> NodeFooterCache::acquire(int chunk, const fs::path &chunkFile, uint64_t recordCount)
+{
+    lock_guard<mutex> lock(cacheMutex);
+
+    auto it = entries.find(chunk);
+    if (it != entries.end())
+    {
+        if (it->second->recordCount == recordCount)
+        {
+            lru.splice(lru.begin(), lru, it->second);
+            return it->second->footer;
+        }
+        lru.erase(it->second);
+        entries.erase(it);
+    }
+
+    auto footer = make_shared<NodeFooter>();
+    if (!footer->open(chunkFile, recordCount))
+        footer = nullptr;
+
+    lru.push_front({chunk, recordCount, footer});
+    entries[chunk] = lru.begin();
+
+    while (lru.size() > capacity)
+    {
+        entries.erase(lru.back().chunk);
+        lru.pop_back();
+    }
+    return footer;
+}
+
+void NodeFooterCache::invalidate(int chunk)
+{
+    lock_guard<mutex> lock(cacheMutex);
+
+    auto it = entries.find(chunk);
+    if (it == entries.end())
+        return;
+
+    lru.erase(it->second);
+    entries.erase(it);
+}
+
+void NodeFooterCache::clear()
+{
+    lock_guard<mutex> lock(cacheMutex);
+    lru.clear();
+    entries.clear();
+}
@@ -0,0 +1,97 @@
+#include "node_index.hpp"
+#include <algorithm>
+
+using namespace std;
+using namespace graphdb;
+
+namespace
+{
+    // Fill limit of 17/20; linear probing slows down sharply beyond that
+    const size_t LOAD_NUMERATOR = 17;
+    const size_t LOAD_DENOMINATOR = 20;
+    const size_t MIN_CAPACITY = 16;
+
+    size_t capacityFor(size_t entries)
+    {
+        return max(MIN_CAPACITY, entries * LOAD_DENOMINATOR / LOAD_NUMERATOR + 1);
+    }
+}
+
+uint64_t graphdb::hashNodeId(string_view id)
+{
+    uint64_t h = 0xCBF29CE484222325ull;
+    for (char c : id)
+    {
+        h ^= static_cast<uint8_t>(c);
+        h *= 0x100000001B3ull;
+    }
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBull;
+    h ^= h >> 31;
+    return h;
+}
+
+
+void NodeIndex::clear()
+{
+    vector<Slot>().swap(slots);
+    count = 0;
+}
+
+void NodeIndex::reserve(size_t expected)
+{
+    if (capacityFor(expected) > slots.size())
+        rehash(capacityFor(expected));
+}
+
+void NodeIndex::rehash(size_t capacity)
+{
+    vector<Slot> old(capacity);
+    old.swap(slots);
+
+    for (const Slot &entry : old)
+    {
+        if (entry.hash == 0)
+            continue;
+        size_t slot = home(entry.hash);
+        while (slots[slot].hash != 0)
+            slot = next(slot);
+        slots[slot] = entry;
+    }
+}
+
+void NodeIndex::insert(uint64_t hash, NodeLocation location)
+{
+    // Growing by a quarter instead of doubling keeps the table close to its fill limit
+    if ((count + 1) * LOAD_DENOMINATOR > slots.size() * LOAD_NUMERATOR)
+        rehash(max(capacityFor(count + 1), slots.size() + slots.size() / 4));
+
+    size_t slot = home(hash);
+    while (slots[slot].hash != 0)
+        slot = next(slot);
+    slots[slot] = {hash, location};
+    ++count;
+}
+
+void NodeIndex::erase(size_t slot)
+{
+    // Backward shift: later members of the probe run move up into the hole, so
+    // lookups never need tombstones to keep probing past it
+    size_t hole = slot;
+    for (size_t current = next(hole); slots[current].hash != 0; current = next(current))
+    {
+        size_t wanted = home(slots[current].hash);
+        // An entry may fill the hole only if the hole lies on its way from home to where it sits
+        bool movable = hole <= current ? (wanted <= hole || wanted > current)
+                                       : (wanted <= hole && wanted > current);
+        if (movable)
+        {
+            slots[hole] = slots[current];
+            hole = current;
+        }
+    }
+    slots[hole] = Slot{};
+    --count;
+}
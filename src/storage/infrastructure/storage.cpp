@@ -1,22 +1,121 @@
 #include "storage.hpp"
 #include "node.hpp"
+#include "index_file.hpp"
+#include "tombstone_file.hpp"
+#include "node_footer.hpp"
+#include "chunk_format.hpp"
+#include "dictionary_file.hpp"
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_set>
 
 using namespace std;
 using namespace graphdb;
 
 namespace fs = filesystem;
 
+namespace
+{
+    const char KEYS_MAGIC[4] = {'G', 'D', 'K', 'D'};
+    const char VALUES_MAGIC[4] = {'G', 'D', 'V', 'D'};
+
+    // Runs task(0) .. task(count - 1) on up to one thread per core; each thread takes the next index.
+    // The first exception a task throws is rethrown once every thread has stopped.
+    void forEachParallel(size_t count, const function<void(size_t)> &task)
+    {
+        size_t threadCount = min<size_t>(max(thread::hardware_concurrency(), 1u), count);
+        if (threadCount <= 1)
+        {
+            for (size_t i = 0; i < count; ++i)
+                task(i);
+            return;
+        }
+
+        atomic<size_t> next{0};
+        mutex errorMutex;
+        exception_ptr error;
+        auto worker = [&]
+        {
+            try
+            {
+                for (size_t i = next++; i < count; i = next++)
+                    task(i);
+            }
+            catch (...)
+            {
+                // An exception escaping a thread would terminate the process
+                lock_guard<mutex> lock(errorMutex);
+                if (!error)
+                    error = current_exception();
+                next = count;
+            }
+        };
+
+        vector<thread> workers;
+        workers.reserve(threadCount - 1);
+        for (size_t i = 1; i < threadCount; ++i)
+            workers.emplace_back(worker);
+        worker();
+        for (auto &t : workers)
+            t.join();
+
+        if (error)
+            rethrow_exception(error);
+    }
+
+    // After a restart the highest chunk becomes the active one, which may be a
+    // compaction output compressed since; compressed chunks are sealed for good
+    bool acceptsAppends(const fs::path &file)
+    {
+        ifstream in(file, ios::binary);
+        ChunkHeader header;
+        return header.read(in) && !header.compressed();
+    }
+}
+
+int Storage::chunkNumber(const fs::path &file, const string &prefix)
+{
+    string name = file.filename().string();
+    if (file.extension() != ".bin" || name.rfind(prefix + "_", 0) != 0)
+        return -1;
+
+    try
+    {
+        return stoi(name.substr(prefix.size() + 1, name.size() - prefix.size() - 5));
+    }
+    catch (...)
+    {
+        return -1;
+    }
+}
+
 // Constructor (Box init)
 Storage::Storage(const string &basePath) 
     : boxName(basePath), 
       lastNodeChunkIdx(0), 
       lastEdgeChunkIdx(0),
+      highestNodeChunkIdx(0),
+      highestEdgeChunkIdx(0),
       NODES_BASE_PATH(fs::path(basePath) / "nodes"),
-      EDGES_BASE_PATH(fs::path(basePath) / "edges")
+      EDGES_BASE_PATH(fs::path(basePath) / "edges"),
+      NODE_INDEX_PATH(fs::path(basePath) / "nodes.idx"),
+      EDGE_INDEX_PATH(fs::path(basePath) / "edges.idx"),
+      COMPACTION_JOURNAL_PATH(fs::path(basePath) / "compaction.journal"),
+      WAL_PATH(fs::path(basePath) / "wal.log"),
+      CHECKPOINT_PATH(fs::path(basePath) / "wal.ckpt"),
+      SNAPSHOT_PATH(fs::path(basePath) / "graph.csr"),
+      KEYS_PATH(fs::path(basePath) / "keys.dict"),
+      VALUES_PATH(fs::path(basePath) / "values.dict")
 {
     // Logowanie rozpoczęcia inicjalizacji
     printf("Storage constructor: Initializing storage at base path: %s\n", basePath.c_str());
@@ -45,9 +144,9 @@ Storage::Storage(const string &basePath)
                     {
                         try
                         {
-                            size_t idx = stoi(name.substr(prefix.size() + 1, name.size() - prefix.size() - 5));
-                            if (idx > static_cast<size_t>(lastIdx))
-                                lastIdx = static_cast<int>(idx);
+                            int idx = stoi(name.substr(prefix.size() + 1, name.size() - prefix.size() - 5));
+                            if (idx > lastIdx)
+                                lastIdx = idx;
                         }
                         catch (...) { printf("Warning: bad filename format in %s\n", entry.path().string().c_str()); fflush(stdout); }
                     }
@@ -63,8 +162,32 @@ Storage::Storage(const string &basePath)
             fflush(stdout);
         };
 
+        recoverCompaction();
+        recoverCheckpoint();
+
         initFolder(NODES_BASE_PATH, "nodes", lastNodeChunkIdx);
         initFolder(EDGES_BASE_PATH, "edges", lastEdgeChunkIdx);
+        highestNodeChunkIdx = lastNodeChunkIdx;
+        highestEdgeChunkIdx = lastEdgeChunkIdx;
+
+        if (!DictionaryFile::load(KEYS_PATH, KEYS_MAGIC, [this](const string &key) { dictionaries.keys.intern(key); }))
+            throw runtime_error("Cannot read key dictionary: " + KEYS_PATH);
+        persistedKeys = dictionaries.keys.size();
+
+        // Value entries are [u32 key id][value]
+        bool valuesLoaded = DictionaryFile::load(VALUES_PATH, VALUES_MAGIC, [this](const string &entry)
+        {
+            uint32_t keyId = 0;
+            memcpy(&keyId, entry.data(), min(entry.size(), sizeof(keyId)));
+            dictionaries.values.restore(keyId, entry.size() > sizeof(keyId) ? entry.substr(sizeof(keyId)) : string());
+        });
+        if (!valuesLoaded)
+            throw runtime_error("Cannot read value dictionary: " + VALUES_PATH);
+        persistedValues = dictionaries.values.size();
+
+        if (!wal.open(WAL_PATH))
+            throw runtime_error("Cannot open write-ahead log: " + WAL_PATH);
+
         printf("Storage constructor: Initialization finished successfully.\n");
         fflush(stdout);
         
@@ -75,185 +198,557 @@ Storage::Storage(const string &basePath)
     }
 }
 
-// ====================== DELETE NODE ======================
-void Storage::deleteNode(const string &nodeId)
+Storage::~Storage()
 {
-    auto it = nodeIndex.find(nodeId);
-    if (it == nodeIndex.end())
+    stopBackgroundCompaction();
+
+    try
     {
-        // Node doesn't exist, nothing to delete
-        printf("deleteNode: Node %s not found in index, skipping deletion.\n", nodeId.c_str());
+        checkpoint();
+    }
+    catch (const exception &e)
+    {
+        printf("Storage destructor: Checkpoint failed, changes stay in the WAL: %s\n", e.what());
         fflush(stdout);
-        return;
     }
 
-    const string &filePath = it->second.first;
-    
-    printf("deleteNode: Attempting to delete node %s from file %s\n", nodeId.c_str(), filePath.c_str());
-    fflush(stdout);
-    
-    // Read the entire file
-    ifstream in(filePath, ios::binary);
-    if (!in)
+    try
+    {
+        persistNodeIndex();
+    }
+    catch (const exception &e)
     {
-        printf("deleteNode: Cannot open file for reading: %s\n", filePath.c_str());
+        printf("Storage destructor: Failed to persist node index: %s\n", e.what());
         fflush(stdout);
-        return;
     }
 
-    size_t nodeCount;
-    if (!in.read(reinterpret_cast<char *>(&nodeCount), sizeof(nodeCount)))
+    try
+    {
+        persistEdgeIndex();
+    }
+    catch (const exception &e)
     {
-        printf("deleteNode: Error reading node count from file: %s\n", filePath.c_str());
+        printf("Storage destructor: Failed to persist edge index: %s\n", e.what());
         fflush(stdout);
-        in.close();
+    }
+}
+
+// ====================== WRITE-AHEAD LOG ======================
+void Storage::saveNodes(const vector<Node> &nodes)
+{
+    if (nodes.empty())
         return;
+
+    BinaryWriter payload;
+    payload.writeRaw(nodes.size());
+    for (const auto &node : nodes)
+        node.serialize(payload, RecordFormat::V1);
+
+    // Log order and memtable order must agree, so both happen under the lock;
+    // waiting for the sync does not, which is what lets concurrent saves share one fdatasync
+    uint64_t ticket;
+    {
+        lock_guard<recursive_mutex> lock(storageMutex);
+        ticket = wal.append(WalRecordType::SaveNodes, payload.str());
+        applyNodes(nodes);
     }
 
-    vector<Node> nodes;
-    size_t offset = sizeof(nodeCount);
+    if (!wal.waitDurable(ticket))
+    {
+        discardUnloggedChanges();
+        throw runtime_error("Write-ahead log write failed: " + WAL_PATH);
+    }
+
+    checkpointIfNeeded();
+}
+
+void Storage::saveEdges(const vector<Edge> &edges)
+{
+    if (edges.empty())
+        return;
+
+    BinaryWriter payload;
+    payload.writeRaw(edges.size());
+    for (const auto &edge : edges)
+        edge.serialize(payload, RecordFormat::V1);
 
-    // Read all nodes except the one to delete
-    for (size_t i = 0; i < nodeCount; ++i)
+    uint64_t ticket;
     {
-        size_t idLen;
-        size_t nodeStartOffset = offset;
-        if (!in.read(reinterpret_cast<char *>(&idLen), sizeof(idLen)))
-        {
-            printf("deleteNode: Error reading id length at offset %zu\n", offset);
-            fflush(stdout);
-            break;
-        }
+        lock_guard<recursive_mutex> lock(storageMutex);
+        ticket = wal.append(WalRecordType::SaveEdges, payload.str());
+        applyEdges(edges);
+    }
+
+    if (!wal.waitDurable(ticket))
+    {
+        discardUnloggedChanges();
+        throw runtime_error("Write-ahead log write failed: " + WAL_PATH);
+    }
+
+    checkpointIfNeeded();
+}
 
-        string id(idLen, '\0');
-        if (!in.read(&id[0], idLen))
+void Storage::removeNode(const string &nodeId)
+{
+    uint64_t ticket;
+    {
+        lock_guard<recursive_mutex> lock(storageMutex);
+        if (!pendingNodes.count(nodeId) && (pendingNodeDeletes.count(nodeId) || findNode(nodeId) == NodeIndex::NONE))
         {
-            printf("deleteNode: Error reading id at offset %zu\n", offset);
+            printf("removeNode: Node %s not found, skipping deletion.\n", nodeId.c_str());
             fflush(stdout);
-            break;
+            return;
         }
 
-        size_t propCount;
-        if (!in.read(reinterpret_cast<char *>(&propCount), sizeof(propCount)))
+        BinaryWriter payload;
+        payload.writeRaw(nodeId.size());
+        payload.write(nodeId.data(), nodeId.size());
+
+        ticket = wal.append(WalRecordType::DeleteNode, payload.str());
+        applyDelete(nodeId);
+    }
+
+    if (!wal.waitDurable(ticket))
+    {
+        discardUnloggedChanges();
+        throw runtime_error("Write-ahead log write failed: " + WAL_PATH);
+    }
+
+    checkpointIfNeeded();
+}
+
+void Storage::applyNodes(const vector<Node> &nodes)
+{
+    for (const auto &node : nodes)
+    {
+        pendingNodeDeletes.erase(node.id);
+        pendingNodes[node.id] = node;
+        nodeCache.invalidate(node.id);
+    }
+    pendingBytes += estimateNodesSize(nodes);
+}
+
+void Storage::applyEdges(const vector<Edge> &edges)
+{
+    for (const auto &edge : edges)
+        pendingEdges[edge.from].push_back(edge);
+    pendingBytes += estimateEdgesSize(edges);
+}
+
+void Storage::applyDelete(const string &nodeId)
+{
+    // Harmless when the node never reached a chunk - deleteNode skips unknown ids
+    pendingNodes.erase(nodeId);
+    pendingNodeDeletes.insert(nodeId);
+    nodeCache.invalidate(nodeId);
+    pendingBytes += sizeof(size_t) + nodeId.size();
+}
+
+void Storage::applyLogRecord(WalRecordType type, const string &payload)
+{
+    BinaryReader in(payload);
+    size_t count = in.readRaw<size_t>();
+
+    if (type == WalRecordType::SaveNodes)
+    {
+        vector<Node> nodes;
+        for (size_t i = 0; i < count && in; ++i)
+            nodes.push_back(Node::deserialize(in, RecordFormat::V1));
+        if (in)
+            applyNodes(nodes);
+    }
+    else if (type == WalRecordType::SaveEdges)
+    {
+        vector<Edge> edges;
+        for (size_t i = 0; i < count && in; ++i)
+            edges.push_back(Edge::deserialize(in, RecordFormat::V1));
+        if (in)
+            applyEdges(edges);
+    }
+    else if (type == WalRecordType::DeleteNode)
+    {
+        string nodeId(in.readBytes(count));
+        if (in)
+            applyDelete(nodeId);
+    }
+}
+
+void Storage::recoverWriteAheadLog()
+{
+    lock_guard<recursive_mutex> lock(storageMutex);
+
+    // Records up to the marker are in the chunks already; edges would be appended twice
+    size_t records = wal.replay([this](WalRecordType type, const string &payload) { applyLogRecord(type, payload); },
+                                checkpointMarker.materialized);
+
+    printf("recoverWriteAheadLog: Replayed %zu record(s) from %s\n", records, WAL_PATH.c_str());
+    fflush(stdout);
+}
+
+void Storage::discardUnloggedChanges()
+{
+    lock_guard<recursive_mutex> lock(storageMutex);
+
+    // Every writer of the failed batch ends up here; the first one rolls back for all
+    if (!wal.failed())
+        return;
+
+    if (!wal.discardUndurable())
+    {
+        printf("discardUnloggedChanges: Cannot cut %s back to its durable records.\n", WAL_PATH.c_str());
+        fflush(stdout);
+        return;
+    }
+
+    pendingNodes.clear();
+    pendingNodeDeletes.clear();
+    pendingEdges.clear();
+    pendingBytes = 0;
+
+    // What an unfinished checkpoint took out of the memtable is in the chunks already
+    const WalPosition &inChunks = checkpointMarker.inFlight() ? checkpointMarker.appending : checkpointMarker.materialized;
+    size_t records = wal.replay([this](WalRecordType type, const string &payload) { applyLogRecord(type, payload); }, inChunks);
+
+    printf("discardUnloggedChanges: Rebuilt the memtable from %zu durable record(s).\n", records);
+    fflush(stdout);
+}
+
+void Storage::checkpointIfNeeded()
+{
+    lock_guard<recursive_mutex> lock(storageMutex);
+    if (pendingBytes >= MAX_CHUNK_SIZE)
+        checkpoint();
+}
+
+void Storage::checkpoint()
+{
+    lock_guard<recursive_mutex> lock(storageMutex);
+
+    if (pendingNodes.empty() && pendingNodeDeletes.empty() && pendingEdges.empty() && wal.size() == 0)
+        return;
+
+    // Only durable records may reach the chunks, and the marker names exactly the log prefix they came from
+    if (!wal.flush())
+    {
+        discardUnloggedChanges();
+        return;
+    }
+
+    // A checkpoint left in flight is settled first, before its edge append could be
+    // mistaken for part of this one: a failed append is cut off, a missed sync retried
+    if (checkpointMarker.inFlight() && !(edgeAppendFailed ? undoEdgeAppend() : finishCheckpoint()))
+        return;
+    checkpointMarker.appending = wal.position();
+
+    // Deletes first: a node re-saved after its delete has already left pendingNodeDeletes
+    for (const auto &nodeId : pendingNodeDeletes)
+        deleteNode(nodeId);
+    pendingNodeDeletes.clear();
+
+    vector<Node> nodes;
+    nodes.reserve(pendingNodes.size());
+    for (const auto &[id, node] : pendingNodes)
+        nodes.push_back(node);
+
+    vector<Edge> edges;
+    for (const auto &[from, list] : pendingEdges)
+        edges.insert(edges.end(), list.begin(), list.end());
+
+    // On failure the memtable and the log stay as they are and the next checkpoint retries.
+    // Node records and deletes may be materialized twice; edge records may not.
+    if (!saveNodeChunk(nodes))
+    {
+        checkpointMarker.appending = {};
+        return;
+    }
+    pendingNodes.clear();
+
+    if (!saveEdgeChunk(edges))
+    {
+        edgeAppendFailed = !undoEdgeAppend();
+        return;
+    }
+    pendingEdges.clear();
+    pendingBytes = 0;
+
+    // The log may only be emptied once everything it covered is on stable storage;
+    // from then on replay skips it even if the truncation below does not happen
+    if (!finishCheckpoint())
+        return;
+
+    if (!wal.reset())
+    {
+        printf("checkpoint: Cannot truncate %s\n", WAL_PATH.c_str());
+        fflush(stdout);
+        return;
+    }
+
+    printf("checkpoint: Materialized %zu nodes and %zu edges into chunks.\n", nodes.size(), edges.size());
+    fflush(stdout);
+}
+
+bool Storage::finishCheckpoint()
+{
+    for (const auto &file : dirtyFiles)
+    {
+        // Compaction may have removed it since; nothing left to make durable
+        if (!fs::exists(file))
+            continue;
+        if (!syncFile(file))
         {
-            printf("deleteNode: Error reading property count for node %s\n", id.c_str());
+            printf("checkpoint: Cannot sync %s, keeping the WAL.\n", file.c_str());
             fflush(stdout);
-            break;
+            return false;
         }
+    }
 
-        PropertyMap properties;
-        for (size_t j = 0; j < propCount; ++j)
-        {
-            size_t klen;
-            if (!in.read(reinterpret_cast<char *>(&klen), sizeof(klen)))
-            {
-                printf("deleteNode: Error reading key length for property %zu of node %s\n", j, id.c_str());
-                fflush(stdout);
-                break;
-            }
-            string key(klen, '\0');
-            if (!in.read(&key[0], klen))
-            {
-                printf("deleteNode: Error reading key for property %zu of node %s\n", j, id.c_str());
-                fflush(stdout);
-                break;
-            }
+    // The in-memory marker stays in flight until the finished one is on disk
+    CheckpointMarker finished;
+    finished.materialized = checkpointMarker.appending;
+    if (!finished.write(CHECKPOINT_PATH))
+    {
+        printf("checkpoint: Cannot write %s, keeping the WAL.\n", CHECKPOINT_PATH.c_str());
+        fflush(stdout);
+        return false;
+    }
 
-            PropertyValue val = PropertyValue::deserialize(in);
-            properties[key] = val;
-        }
+    checkpointMarker = finished;
+    dirtyFiles.clear();
+    return true;
+}
+
+bool Storage::recordEdgeAppend(const fs::path &file, bool createNewChunk)
+{
+    CheckpointMarker appending = checkpointMarker;
+    appending.edgeFile = file.string();
+    appending.edgeSize = 0;
+    appending.edgeCount = 0;
+    if (!createNewChunk)
+    {
+        ifstream in(file, ios::binary);
+        ChunkHeader header;
+        error_code ec;
+        appending.edgeSize = fs::file_size(file, ec);
+        if (ec || !header.read(in))
+            return false;
+        appending.edgeCount = header.count;
+    }
+
+    if (!appending.write(CHECKPOINT_PATH))
+        return false;
+    checkpointMarker = appending;
+    return true;
+}
+
+bool Storage::undoEdgeAppend()
+{
+    if (!checkpointMarker.edgeFile.empty())
+    {
+        fs::path file = checkpointMarker.edgeFile;
+        unmapChunk(file.string());
+        error_code ec;
 
-        // Only keep nodes that are NOT being deleted
-        if (id != nodeId)
+        if (checkpointMarker.edgeSize == 0)
         {
-            Node node;
-            node.id = id;
-            node.properties = properties;
-            nodes.push_back(node);
+            fs::remove(file, ec);
         }
-        else
+        else if (fs::exists(file))
         {
-            printf("deleteNode: Found node %s to delete, skipping it.\n", id.c_str());
-            fflush(stdout);
+            // Records and the count patch are cut back to what the chunk held before
+            if (fs::file_size(file) > checkpointMarker.edgeSize)
+                fs::resize_file(file, checkpointMarker.edgeSize, ec);
+
+            fstream out(file, ios::binary | ios::in | ios::out);
+            ChunkHeader header;
+            if (ec || !header.read(out))
+                return false;
+            header.count = checkpointMarker.edgeCount;
+            out.seekp(header.countOffset(), ios::beg);
+            out.write(reinterpret_cast<const char *>(&header.count), sizeof(header.count));
+            out.close();
+            if (out.fail() || !syncFile(file))
+                return false;
         }
+        if (ec)
+            return false;
 
-        offset = in.tellg();
+        printf("undoEdgeAppend: Cut the unfinished append off %s\n", file.string().c_str());
+        fflush(stdout);
     }
-    in.close();
 
-    // Rewrite the file with remaining nodes
-    ofstream out(filePath, ios::binary | ios::trunc);
-    if (!out.is_open())
+    // Nothing of the interrupted checkpoint needs undoing any more; its nodes may be written again
+    CheckpointMarker undone;
+    undone.materialized = checkpointMarker.materialized;
+    if (!undone.write(CHECKPOINT_PATH))
+        return false;
+    checkpointMarker = undone;
+    edgeAppendFailed = false;
+    return true;
+}
+
+void Storage::recoverCheckpoint()
+{
+    if (!checkpointMarker.read(CHECKPOINT_PATH))
+        throw runtime_error("Cannot read checkpoint marker: " + CHECKPOINT_PATH);
+
+    if (checkpointMarker.inFlight() && !undoEdgeAppend())
+        throw runtime_error("Cannot undo the edge append of an interrupted checkpoint in " + checkpointMarker.edgeFile);
+}
+
+// ====================== DELETE NODE ======================
+void Storage::deleteNode(const string &nodeId)
+{
+    lock_guard<recursive_mutex> lock(storageMutex);
+
+    size_t slot = findNode(nodeId);
+    if (slot == NodeIndex::NONE)
     {
-        printf("deleteNode: Cannot open file for writing: %s\n", filePath.c_str());
+        // Node doesn't exist, nothing to delete
+        printf("deleteNode: Node %s not found in index, skipping deletion.\n", nodeId.c_str());
         fflush(stdout);
         return;
     }
 
-    size_t newCount = nodes.size();
-    out.write(reinterpret_cast<const char *>(&newCount), sizeof(newCount));
+    const string filePath = nodeChunkPath(nodeIndex.at(slot).chunk);
+    size_t offset = nodeIndex.at(slot).offset;
 
-    for (const auto &node : nodes)
+    // Measure the record so compaction knows how many bytes of the chunk are dead
+    size_t length = 0;
+    if (auto mapping = mapChunk(filePath))
     {
-        size_t len = node.id.size();
-        out.write(reinterpret_cast<const char *>(&len), sizeof(len));
-        out.write(node.id.c_str(), len);
-
-        size_t propCount = node.properties.size();
-        out.write(reinterpret_cast<const char *>(&propCount), sizeof(propCount));
-
-        for (const auto &[key, value] : node.properties)
+        ChunkReader reader(*mapping, &dictionaries);
+        if (reader.valid())
         {
-            size_t klen = key.size();
-            out.write(reinterpret_cast<const char *>(&klen), sizeof(klen));
-            out.write(key.c_str(), klen);
-
-            value.serialize(out);
+            reader.seek(offset);
+            reader.readNodeView();
+            if (reader.good())
+                length = reader.tell() - offset;
         }
     }
-    out.close();
 
-    printf("deleteNode: Successfully deleted node %s from %s. Remaining nodes: %zu\n", nodeId.c_str(), filePath.c_str(), newCount);
+    // The chunk stays untouched - the record is only marked dead in its tombstone file
+    if (!TombstoneFile::append(filePath, {{offset, length}}))
+    {
+        printf("deleteNode: Cannot append tombstone for %s to %s\n", nodeId.c_str(), TombstoneFile::pathFor(filePath).string().c_str());
+        fflush(stdout);
+        return;
+    }
+
+    nodeFilter.erase(NodeIndex::hashId(nodeId));
+    nodeCache.invalidate(nodeId);
+    nodeIndex.erase(slot);
+    dirtyFiles.insert(TombstoneFile::pathFor(filePath).string());
+
+    printf("deleteNode: Successfully deleted node %s from %s (%zu bytes).\n", nodeId.c_str(), filePath.c_str(), length);
     fflush(stdout);
+
+    addDeadBytes(length);
+}
+
+void Storage::addDeadBytes(size_t length)
+{
+    // Enough garbage piled up to be worth waking the compactor early
+    deadBytesSinceCompaction += length;
+    if (deadBytesSinceCompaction >= MAX_CHUNK_SIZE / 2)
+    {
+        deadBytesSinceCompaction = 0;
+        requestCompaction();
+    }
 }
 
 // ====================== SAVE NODE CHUNK ======================
-void Storage::saveNodeChunk(const vector<Node> &nodes)
+bool Storage::saveNodeChunk(const vector<Node> &nodes)
 {
+    lock_guard<recursive_mutex> lock(storageMutex);
+
     if (nodes.empty())
-        return;
+        return true;
         
     // Log start
     printf("saveNodeChunk: Attempting to save %zu nodes.\n", nodes.size());
     fflush(stdout);
     
-    // Delete any existing nodes with the same IDs to avoid duplicates and wasted space
-    for (const auto &node : nodes)
+    // Only the last occurrence of an id within the batch is kept - earlier copies
+    // would be dead on arrival and could never be tombstoned
+    unordered_map<string, size_t> lastOccurrence;
+    for (size_t i = 0; i < nodes.size(); ++i)
+        lastOccurrence[nodes[i].id] = i;
+
+    vector<const Node *> batch;
+    batch.reserve(lastOccurrence.size());
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        if (lastOccurrence[nodes[i].id] == i)
+            batch.push_back(&nodes[i]);
+    }
+
+    // Keys and values must be on disk before any record refers to them
+    for (const Node *node : batch)
+        dictionaries.internAll(node->properties);
+    if (!persistDictionaries())
+    {
+        printf("saveNodeChunk: CRITICAL ERROR - Cannot persist record dictionaries.\n");
+        fflush(stdout);
+        return false;
+    }
+
+    // Ids that already have a record are grouped by chunk, so each chunk is opened once
+    unordered_map<string, vector<pair<const Node *, size_t>>> existing;
+    vector<const Node *> appended;
+    for (const Node *node : batch)
+    {
+        nodeCache.invalidate(node->id);
+        size_t slot = findNode(node->id);
+        if (slot != NodeIndex::NONE)
+            existing[nodeChunkPath(nodeIndex.at(slot).chunk)].emplace_back(node, nodeIndex.at(slot).offset);
+        else
+            appended.push_back(node);
+    }
+
+    // Records whose new encoding fits the old slot are overwritten there; the rest
+    // are appended below and their old slot tombstoned once the append succeeded
+    unordered_map<string, vector<Tombstone>> replaced;
     {
-        if (nodeIndex.find(node.id) != nodeIndex.end())
+        // Compaction passes read sealed chunks without storageMutex, so nothing is
+        // overwritten while one is running
+        unique_lock<mutex> pass(compactionPassMutex, try_to_lock);
+        for (const auto &[file, records] : existing)
         {
-            printf("saveNodeChunk: Node %s already exists, deleting old version first.\n", node.id.c_str());
-            fflush(stdout);
-            deleteNode(node.id);
+            vector<pair<const Node *, Tombstone>> leftovers;
+            if (!overwriteNodes(file, records, pass.owns_lock(), leftovers))
+                return false;
+
+            for (const auto &[node, tombstone] : leftovers)
+            {
+                appended.push_back(node);
+                replaced[file].push_back(tombstone);
+            }
         }
     }
-    
-    // Rebuild index after deletions to ensure it's up to date
-    buildNodeIndex();
 
-    // 1. Filename for the next potential chunk
-    fs::path nextFile = fs::path(NODES_BASE_PATH) / ("nodes_" + to_string(lastNodeChunkIdx + 1) + ".bin");
+    if (appended.empty())
+    {
+        printf("saveNodeChunk: SUCCESS - Overwrote %zu nodes in place\n", batch.size());
+        fflush(stdout);
+        return true;
+    }
+
+    // 1. Append to the active chunk while it has room
+    fs::path activeFile = fs::path(NODES_BASE_PATH) / ("nodes_" + to_string(lastNodeChunkIdx) + ".bin");
 
     bool createNewChunk = true;
-    size_t newDataSize = estimateNodesSize(nodes);
+    // Records overwritten in place above take no new space in the chunk
+    size_t newDataSize = 0;
+    for (const Node *node : appended)
+        newDataSize += estimateNodeSize(*node);
 
-    if (fs::exists(nextFile))
+    if (lastNodeChunkIdx > 0 && fs::exists(activeFile) && acceptsAppends(activeFile))
     {
-        auto currentSize = fs::file_size(nextFile);
+        auto currentSize = fs::file_size(activeFile);
         if (currentSize + newDataSize <= MAX_CHUNK_SIZE)
         {
             createNewChunk = false;
-            printf("saveNodeChunk: Appending to existing file: %s\n", nextFile.string().c_str());
+            printf("saveNodeChunk: Appending to existing file: %s\n", activeFile.string().c_str());
             fflush(stdout);
         }
     }
@@ -261,154 +756,244 @@ void Storage::saveNodeChunk(const vector<Node> &nodes)
     fs::path targetFile;
     if (createNewChunk)
     {
-        lastNodeChunkIdx++;
-        // 🚨 CRITICAL LOGIC FIX
-        // Should use the new index (lastNodeChunkIdx), not the old one (lastNodeChunkIdx - 1).
+        lastNodeChunkIdx = ++highestNodeChunkIdx;
         targetFile = fs::path(NODES_BASE_PATH) / ("nodes_" + to_string(lastNodeChunkIdx) + ".bin");
         printf("saveNodeChunk: Creating NEW chunk with index %d. File: %s\n", lastNodeChunkIdx, targetFile.string().c_str());
         fflush(stdout);
+        // Tombstones and footers only ever belong to the chunk they were written for
+        fs::remove(TombstoneFile::pathFor(targetFile));
+        fs::remove(NodeFooter::pathFor(targetFile));
     } else {
-        targetFile = nextFile;
+        targetFile = activeFile;
     }
 
-    // 2. File opening
-    ofstream out(targetFile, ios::binary | (createNewChunk ? ios::trunc : ios::app));
+    // 2. File opening - a single read/write stream serves both the header patch and the append
+    unmapChunk(targetFile.string());
+    fstream out(targetFile, ios::binary | ios::out | (createNewChunk ? ios::trunc : ios::in));
     
     // Using .is_open() for a precise check
     if (!out.is_open()) 
     {
         printf("saveNodeChunk: CRITICAL ERROR - Cannot open file for writing: %s. Check permissions and path.\n", targetFile.string().c_str());
         fflush(stdout);
-        return;
+        return false;
     }
     
     printf("saveNodeChunk: File opened successfully for %s mode.\n", createNewChunk ? "TRUNCATE" : "APPEND");
     fflush(stdout);
 
-    if (!createNewChunk)
+    // 3. Header: new chunks are written in the current format, existing ones keep
+    //    theirs and only get the count patched
+    ChunkHeader header;
+    if (!createNewChunk && !header.read(out))
     {
-        // 3. APPEND (Append) Logic
-        // ... (Code to read and update the count)
-        
-        // Reopening for read and write is risky, but if it works, we leave it.
-        // Correct count update in the file is necessary.
-        size_t oldCount;
-        ifstream in(targetFile, ios::binary);
-        if (!in.read(reinterpret_cast<char *>(&oldCount), sizeof(oldCount))) {
-             printf("saveNodeChunk: Error reading old count from file.\n");
-             fflush(stdout);
-             return;
-        }
-        in.close();
+        printf("saveNodeChunk: Error reading chunk header from file.\n");
+        fflush(stdout);
+        return false;
+    }
 
-        size_t newCount = oldCount + nodes.size();
-        
-        // Open the file for reading and writing
-        fstream updateCount(targetFile, ios::binary | ios::in | ios::out);
-        
-        // Write the new count at the beginning of the file
-        updateCount.write(reinterpret_cast<const char *>(&newCount), sizeof(newCount));
-        
-        // Seek to the end of the file to append new nodes
-        updateCount.seekp(0, ios::end); 
-        
-        for (const auto &node : nodes)
-        {
-            // ... (node data write logic)
-            size_t len = node.id.size();
-            updateCount.write(reinterpret_cast<const char *>(&len), sizeof(len));
-            updateCount.write(node.id.c_str(), len);
+    if (createNewChunk)
+        header.write(out);
+    header.count += appended.size();
+    out.seekp(header.countOffset(), ios::beg);
+    out.write(reinterpret_cast<const char *>(&header.count), sizeof(header.count));
+    out.seekp(0, ios::end);
+
+    // 4. Records - encoded into one buffer, remembering where each one starts so the
+    //    index can be updated in place, then written with a single call
+    size_t base = static_cast<size_t>(out.tellp());
+    vector<size_t> offsets;
+    offsets.reserve(appended.size());
+    BinaryWriter records;
+    records.reserve(newDataSize);
+
+    for (const Node *node : appended)
+    {
+        offsets.push_back(base + records.size());
+        node->serialize(records, header.format, &dictionaries);
+    }
 
-            size_t propCount = node.properties.size();
-            updateCount.write(reinterpret_cast<const char *>(&propCount), sizeof(propCount));
+    // The node index stores 32-bit offsets
+    if (base + records.size() > UINT32_MAX)
+    {
+        printf("saveNodeChunk: CRITICAL ERROR - Batch does not fit into chunk %s\n", targetFile.string().c_str());
+        fflush(stdout);
+        return false;
+    }
+    out.write(records.data(), records.size());
+    out.close();
 
-            for (const auto &[key, value] : node.properties)
-            {
-                size_t klen = key.size();
-                updateCount.write(reinterpret_cast<const char *>(&klen), sizeof(klen));
-                updateCount.write(key.c_str(), klen);
+    if (out.fail())
+    {
+        printf("saveNodeChunk: CRITICAL ERROR - Write failed for file: %s\n", targetFile.string().c_str());
+        fflush(stdout);
+        return false;
+    }
 
-                value.serialize(updateCount);
-            }
+    for (size_t i = 0; i < appended.size(); ++i)
+    {
+        NodeLocation location{static_cast<uint32_t>(lastNodeChunkIdx), static_cast<uint32_t>(offsets[i])};
+        if (placeNode(appended[i]->id, location) && !nodeFilter.insert(NodeIndex::hashId(appended[i]->id)))
+            rebuildNodeFilter();
+    }
+    dirtyFiles.insert(targetFile.string());
+
+    // The moved records are live in their new place now, so the old slots can go
+    size_t deadBytes = 0;
+    for (const auto &[file, tombstones] : replaced)
+    {
+        if (!TombstoneFile::append(file, tombstones))
+        {
+            printf("saveNodeChunk: Cannot append tombstones to %s\n", TombstoneFile::pathFor(file).string().c_str());
+            fflush(stdout);
+            continue;
         }
-        updateCount.close();
-        
-        // Replaced cout message at the end:
-        // cout << "Saved " << nodes.size() << " nodes to " << targetFile << "\n"; 
-        
+        dirtyFiles.insert(TombstoneFile::pathFor(file).string());
+        for (const auto &tombstone : tombstones)
+            deadBytes += tombstone.length;
     }
-    else
+    
+    // Using printf for better cross-platform logging
+    printf("saveNodeChunk: SUCCESS - Wrote %zu nodes to %s, %zu in place\n", appended.size(), targetFile.string().c_str(), batch.size() - appended.size());
+    fflush(stdout);
+
+    addDeadBytes(deadBytes);
+    return true;
+}
+
+bool Storage::overwriteNodes(const string &file, const vector<pair<const Node *, size_t>> &records, bool inPlace,
+                             vector<pair<const Node *, Tombstone>> &leftovers)
+{
+    struct Patch
     {
-        // 4. TRUNCATE Logic (new file)
-        
-        // write new file
-        size_t nodeCount = nodes.size();
-        out.write(reinterpret_cast<const char *>(&nodeCount), sizeof(nodeCount));
+        size_t offset;
+        string bytes;
+    };
+    vector<Patch> patches;
 
-        for (const auto &node : nodes)
+    {
+        auto mapping = mapChunk(file);
+        if (!mapping)
         {
-            size_t len = node.id.size();
-            out.write(reinterpret_cast<const char *>(&len), sizeof(len));
-            out.write(node.id.c_str(), len);
+            for (const auto &[node, offset] : records)
+                leftovers.push_back({node, {offset, 0}});
+            return true;
+        }
 
-            size_t propCount = node.properties.size();
-            out.write(reinterpret_cast<const char *>(&propCount), sizeof(propCount));
+        ChunkReader reader(*mapping, &dictionaries);
+        RecordFormat format = reader.header().format;
+        // Compressed chunks keep record offsets but not the byte layout behind them
+        bool writable = inPlace && reader.valid() && !reader.header().compressed();
 
-            for (const auto &[key, value] : node.properties)
+        for (const auto &[node, offset] : records)
+        {
+            // The old slot: the whole record, and for V5 the part behind its length prefix
+            size_t slot = 0;
+            size_t prefix = 0;
+            if (reader.valid())
+            {
+                reader.seek(offset);
+                if (format >= RecordFormat::V5)
+                {
+                    reader.readLength();
+                    prefix = reader.tell() - offset;
+                    reader.seek(offset);
+                }
+                reader.readNodeView();
+                if (reader.good())
+                    slot = reader.tell() - offset;
+            }
+
+            if (writable && slot > 0)
             {
-                size_t klen = key.size();
-                out.write(reinterpret_cast<const char *>(&klen), sizeof(klen));
-                out.write(key.c_str(), klen);
+                BinaryWriter buf;
+                node->serialize(buf, format, &dictionaries);
+                const string &encoded = buf.str();
 
-                value.serialize(out);
+                if (encoded.size() == slot)
+                {
+                    patches.push_back({offset, encoded});
+                    continue;
+                }
+
+                // A shorter V5 record keeps the old length prefix and is zero-padded up to it;
+                // readers always continue at the end the prefix names
+                if (format >= RecordFormat::V5 && encoded.size() < slot)
+                {
+                    BinaryReader in(encoded);
+                    size_t bodyLength = readLength(in, format);
+                    size_t bodyStart = in.tell();
+                    if (in && bodyLength <= slot - prefix)
+                    {
+                        string bytes = encoded.substr(bodyStart);
+                        bytes.resize(slot - prefix, '\0');
+                        patches.push_back({offset + prefix, move(bytes)});
+                        continue;
+                    }
+                }
             }
+
+            leftovers.push_back({node, {offset, slot}});
         }
-        out.close();
     }
-    
-    // Using printf for better cross-platform logging
-    printf("saveNodeChunk: SUCCESS - Wrote %zu nodes to %s\n", nodes.size(), targetFile.string().c_str());
-    fflush(stdout);
+
+    if (patches.empty())
+        return true;
+
+    unmapChunk(file);
+    fstream out(file, ios::binary | ios::in | ios::out);
+    for (const auto &patch : patches)
+    {
+        out.seekp(patch.offset, ios::beg);
+        out.write(patch.bytes.data(), patch.bytes.size());
+    }
+    out.close();
+
+    if (out.fail())
+    {
+        printf("saveNodeChunk: CRITICAL ERROR - In-place write failed for file: %s\n", file.c_str());
+        fflush(stdout);
+        return false;
+    }
+
+    dirtyFiles.insert(file);
+    return true;
 }
 
 // ====================== Save edges chunk ======================
-void Storage::saveEdgeChunk(const vector<Edge> &edges)
+bool Storage::saveEdgeChunk(const vector<Edge> &edges)
 {
+    lock_guard<recursive_mutex> lock(storageMutex);
+
     if (edges.empty())
-        return;
+        return true;
         
     // Log start
     printf("saveEdgeChunk: Attempting to save %zu edges.\n", edges.size());
     fflush(stdout);
 
-    // 1. Filename for the next potential chunk
-    fs::path nextFile = fs::path(EDGES_BASE_PATH) / ("edges_" + to_string(lastEdgeChunkIdx + 1) + ".bin");
+    // Records are clustered by source so each source of the batch lands as one contiguous run
+    vector<const Edge *> batch;
+    batch.reserve(edges.size());
+    for (const auto &e : edges)
+        batch.push_back(&e);
+    stable_sort(batch.begin(), batch.end(),
+                [](const Edge *a, const Edge *b) { return a->from < b->from; });
+
+    // 1. Append to the active chunk while it has room
+    fs::path activeFile = fs::path(EDGES_BASE_PATH) / ("edges_" + to_string(lastEdgeChunkIdx) + ".bin");
 
     bool createNewChunk = true;
     
-    if (fs::exists(nextFile))
+    if (lastEdgeChunkIdx > 0 && fs::exists(activeFile) && acceptsAppends(activeFile))
     {
-        auto currentSize = fs::file_size(nextFile);
-        // Estimate size: each edge has from, to, weight, and properties
-        size_t estimatedSize = 0;
-        for (const auto &e : edges)
-        {
-            estimatedSize += sizeof(size_t) + e.from.size();
-            estimatedSize += sizeof(size_t) + e.to.size();
-            estimatedSize += sizeof(double); // weight
-            estimatedSize += sizeof(size_t); // prop count
-            for (const auto &[k, v] : e.properties)
-            {
-                estimatedSize += sizeof(size_t) + k.size();
-                // Rough estimate for property value (at least 1 byte for type + some data)
-                estimatedSize += 1 + sizeof(size_t) + 10; // rough estimate
-            }
-        }
+        auto currentSize = fs::file_size(activeFile);
+        size_t estimatedSize = estimateEdgesSize(edges);
         
         if (currentSize + estimatedSize <= MAX_CHUNK_SIZE)
         {
             createNewChunk = false;
-            printf("saveEdgeChunk: Appending to existing file: %s\n", nextFile.string().c_str());
+            printf("saveEdgeChunk: Appending to existing file: %s\n", activeFile.string().c_str());
             fflush(stdout);
         }
     }
@@ -416,117 +1001,106 @@ void Storage::saveEdgeChunk(const vector<Edge> &edges)
     fs::path targetFile;
     if (createNewChunk)
     {
-        lastEdgeChunkIdx++;
+        lastEdgeChunkIdx = ++highestEdgeChunkIdx;
         targetFile = fs::path(EDGES_BASE_PATH) / ("edges_" + to_string(lastEdgeChunkIdx) + ".bin");
         printf("saveEdgeChunk: Creating NEW chunk with index %d. File: %s\n", lastEdgeChunkIdx, targetFile.string().c_str());
         fflush(stdout);
     } else {
-        targetFile = nextFile;
+        targetFile = activeFile;
+    }
+
+    // Keys and values must be on disk before any record refers to them
+    for (const Edge *edge : batch)
+        dictionaries.internAll(edge->properties);
+    if (!persistDictionaries())
+    {
+        printf("saveEdgeChunk: CRITICAL ERROR - Cannot persist record dictionaries.\n");
+        fflush(stdout);
+        return false;
     }
 
-    // 2. File opening
-    ofstream out(targetFile, ios::binary | (createNewChunk ? ios::trunc : ios::app));
+    // Replaying the WAL after a crash mid-checkpoint would append these edges a second
+    // time, so the checkpoint marker learns how to cut them off before the file changes
+    if (checkpointMarker.inFlight() && !recordEdgeAppend(targetFile, createNewChunk))
+    {
+        printf("saveEdgeChunk: CRITICAL ERROR - Cannot record the append in %s\n", CHECKPOINT_PATH.c_str());
+        fflush(stdout);
+        return false;
+    }
+
+    // 2. File opening - a single read/write stream serves both the header patch and the append
+    unmapChunk(targetFile.string());
+    fstream out(targetFile, ios::binary | ios::out | (createNewChunk ? ios::trunc : ios::in));
     
     if (!out.is_open()) 
     {
         printf("saveEdgeChunk: CRITICAL ERROR - Cannot open file for writing: %s. Check permissions and path.\n", targetFile.string().c_str());
         fflush(stdout);
-        return;
+        return false;
     }
     
     printf("saveEdgeChunk: File opened successfully for %s mode.\n", createNewChunk ? "TRUNCATE" : "APPEND");
     fflush(stdout);
 
-    if (!createNewChunk)
+    // 3. Header: new chunks are written in the current format, existing ones keep
+    //    theirs and only get the count patched
+    ChunkHeader header;
+    if (!createNewChunk && !header.read(out))
     {
-        // 3. APPEND Logic
-        size_t oldCount;
-        ifstream in(targetFile, ios::binary);
-        if (!in.read(reinterpret_cast<char *>(&oldCount), sizeof(oldCount))) {
-             printf("saveEdgeChunk: Error reading old count from file.\n");
-             fflush(stdout);
-             in.close();
-             out.close();
-             return;
-        }
-        in.close();
+        printf("saveEdgeChunk: Error reading chunk header from file.\n");
+        fflush(stdout);
+        return false;
+    }
 
-        size_t newCount = oldCount + edges.size();
-        
-        // Open the file for reading and writing
-        fstream updateCount(targetFile, ios::binary | ios::in | ios::out);
-        
-        // Write the new count at the beginning of the file
-        updateCount.write(reinterpret_cast<const char *>(&newCount), sizeof(newCount));
-        
-        // Seek to the end of the file to append new edges
-        updateCount.seekp(0, ios::end); 
-        
-        for (const auto &e : edges)
-        {
-            // from
-            size_t lenFrom = e.from.size();
-            updateCount.write(reinterpret_cast<const char *>(&lenFrom), sizeof(lenFrom));
-            updateCount.write(e.from.c_str(), lenFrom);
-
-            // to
-            size_t lenTo = e.to.size();
-            updateCount.write(reinterpret_cast<const char *>(&lenTo), sizeof(lenTo));
-            updateCount.write(e.to.c_str(), lenTo);
-
-            // weight
-            updateCount.write(reinterpret_cast<const char *>(&e.weight), sizeof(e.weight));
-
-            // properties
-            size_t propCount = e.properties.size();
-            updateCount.write(reinterpret_cast<const char *>(&propCount), sizeof(propCount));
-            for (const auto &[k, v] : e.properties)
-            {
-                size_t klen = k.size();
-                updateCount.write(reinterpret_cast<const char *>(&klen), sizeof(klen));
-                updateCount.write(k.c_str(), klen);
-                v.serialize(updateCount);
-            }
-        }
-        updateCount.close();
+    if (createNewChunk)
+        header.write(out);
+    header.count += batch.size();
+    out.seekp(header.countOffset(), ios::beg);
+    out.write(reinterpret_cast<const char *>(&header.count), sizeof(header.count));
+    out.seekp(0, ios::end);
+
+    // 4. Records - encoded into one buffer, remembering where each one starts so the
+    //    index can be updated in place, then written with a single call
+    size_t base = static_cast<size_t>(out.tellp());
+    vector<size_t> offsets;
+    offsets.reserve(batch.size() + 1);
+    BinaryWriter records;
+    records.reserve(estimateEdgesSize(edges));
+
+    for (const Edge *edge : batch)
+    {
+        offsets.push_back(base + records.size());
+        edge->serialize(records, header.format, &dictionaries);
     }
-    else
+    offsets.push_back(base + records.size());
+    out.write(records.data(), records.size());
+    out.close();
+
+    if (out.fail())
     {
-        // 4. TRUNCATE Logic (new file)
-        size_t edgeCount = edges.size();
-        out.write(reinterpret_cast<const char *>(&edgeCount), sizeof(edgeCount));
+        printf("saveEdgeChunk: CRITICAL ERROR - Write failed for file: %s\n", targetFile.string().c_str());
+        fflush(stdout);
+        return false;
+    }
 
-        for (const auto &e : edges)
-        {
-            // from
-            size_t lenFrom = e.from.size();
-            out.write(reinterpret_cast<const char *>(&lenFrom), sizeof(lenFrom));
-            out.write(e.from.c_str(), lenFrom);
-
-            // to
-            size_t lenTo = e.to.size();
-            out.write(reinterpret_cast<const char *>(&lenTo), sizeof(lenTo));
-            out.write(e.to.c_str(), lenTo);
-
-            // weight
-            out.write(reinterpret_cast<const char *>(&e.weight), sizeof(e.weight));
-
-            // properties
-            size_t propCount = e.properties.size();
-            out.write(reinterpret_cast<const char *>(&propCount), sizeof(propCount));
-            for (const auto &[k, v] : e.properties)
-            {
-                size_t klen = k.size();
-                out.write(reinterpret_cast<const char *>(&klen), sizeof(klen));
-                out.write(k.c_str(), klen);
-                v.serialize(out);
-            }
-        }
-        out.close();
+    for (size_t i = 0; i < batch.size();)
+    {
+        size_t j = i + 1;
+        while (j < batch.size() && batch[j]->from == batch[i]->from)
+            ++j;
+        vector<EdgeRun> &runs = edgeIndex[batch[i]->from];
+
+        // The active chunk sorts after every other, so cached lists just grow at the end
+        addEdgeRun(runs, targetFile.string(), offsets[i], offsets[j]);
+        for (size_t k = i; k < j; ++k)
+            edgeCache.append(batch[k]->from, *batch[k]);
+        i = j;
     }
+    dirtyFiles.insert(targetFile.string());
     
     printf("saveEdgeChunk: SUCCESS - Wrote %zu edges to %s\n", edges.size(), targetFile.string().c_str());
     fflush(stdout);
+    return true;
 }
 
 // ====================== ESTIMATE NODES SIZE ======================
@@ -534,10 +1108,33 @@ size_t Storage::estimateNodesSize(const vector<Node> &nodes)
 {
     size_t total = 0;
     for (const auto &n : nodes)
+        total += estimateNodeSize(n);
+    return total;
+}
+
+size_t Storage::estimateNodeSize(const Node &node)
+{
+    size_t total = sizeof(size_t) + node.id.size();
+    total += sizeof(size_t);
+    for (const auto &[k, v] : node.properties)
     {
-        total += sizeof(size_t) + n.id.size();
-        total += sizeof(size_t);
-        for (const auto &[k, v] : n.properties)
+        total += sizeof(size_t) + k.size();
+        total += v.estimateSize();
+    }
+    return total;
+}
+
+size_t Storage::estimateEdgesSize(const vector<Edge> &edges)
+{
+    // Each edge has from, to, weight, and properties
+    size_t total = 0;
+    for (const auto &e : edges)
+    {
+        total += sizeof(size_t) + e.from.size();
+        total += sizeof(size_t) + e.to.size();
+        total += sizeof(double); // weight
+        total += sizeof(size_t); // prop count
+        for (const auto &[k, v] : e.properties)
         {
             total += sizeof(size_t) + k.size();
             total += v.estimateSize();
@@ -546,108 +1143,379 @@ size_t Storage::estimateNodesSize(const vector<Node> &nodes)
     return total;
 }
 
-// ====================== LOAD NODE BY ID ======================
-Node Storage::loadNodeById(const string &nodeId)
+// ====================== KEY DICTIONARY ======================
+bool Storage::persistDictionaries()
 {
-    auto it = nodeIndex.find(nodeId);
-    if (it == nodeIndex.end())
+    lock_guard<mutex> lock(dictionaryFileMutex);
+
+    // Keys first: value entries refer to key ids
+    vector<string> freshKeys = dictionaries.keys.keysFrom(persistedKeys);
+    if (!DictionaryFile::append(KEYS_PATH, KEYS_MAGIC, freshKeys))
+        return false;
+    persistedKeys += freshKeys.size();
+
+    vector<string> freshValues;
+    for (const auto &[keyId, value] : dictionaries.values.entriesFrom(persistedValues))
     {
-        throw runtime_error("NodeID not found in index: " + nodeId);
+        string entry(reinterpret_cast<const char *>(&keyId), sizeof(keyId));
+        entry.append(value);
+        freshValues.push_back(move(entry));
     }
+    if (!DictionaryFile::append(VALUES_PATH, VALUES_MAGIC, freshValues))
+        return false;
+    persistedValues += freshValues.size();
+    return true;
+}
+
+// ====================== CHUNK MAPPINGS ======================
+shared_ptr<const MappedFile> Storage::mapChunk(const string &file)
+{
+    int chunk = chunkNumber(file, "nodes");
+    if (chunk >= 0)
+        return nodeChunks.acquire(chunk, file);
 
-    const string &file = it->second.first;
-    size_t offset = it->second.second;
+    chunk = chunkNumber(file, "edges");
+    if (chunk >= 0)
+        return edgeChunks.acquire(chunk, file);
 
-    ifstream in(file, ios::binary);
-    if (!in)
+    return nullptr;
+}
+
+void Storage::unmapChunk(const string &file)
+{
+    int chunk = chunkNumber(file, "nodes");
+    if (chunk >= 0)
     {
-        throw runtime_error("Cannot open file: " + file);
+        nodeChunks.invalidate(chunk);
+        nodeFooters.invalidate(chunk);
     }
 
-    in.seekg(offset);
+    chunk = chunkNumber(file, "edges");
+    if (chunk >= 0)
+        edgeChunks.invalidate(chunk);
+}
 
-    size_t idLen;
-    in.read(reinterpret_cast<char *>(&idLen), sizeof(idLen));
-    string id(idLen, '\0');
-    in.read(&id[0], idLen);
+// ====================== NODE INDEX LOOKUP ======================
+string Storage::nodeChunkPath(uint32_t chunk) const
+{
+    return (fs::path(NODES_BASE_PATH) / ("nodes_" + to_string(chunk) + ".bin")).string();
+}
 
-    size_t propCount;
-    in.read(reinterpret_cast<char *>(&propCount), sizeof(propCount));
+bool Storage::isNodeAt(const NodeLocation &location, string_view nodeId)
+{
+    auto mapping = nodeChunks.acquire(static_cast<int>(location.chunk), nodeChunkPath(location.chunk));
+    if (!mapping)
+        return false;
+
+    ChunkReader reader(*mapping, &dictionaries);
+    if (!reader.valid())
+        return false;
 
-    PropertyMap properties;
-    for (size_t i = 0; i < propCount; ++i)
+    // Reading the id out of a compressed chunk decodes a whole block; its footer rules
+    // out a record filed under another hash first. A hit is still confirmed below.
+    if (reader.header().compressed())
     {
-        size_t klen;
-        in.read(reinterpret_cast<char *>(&klen), sizeof(klen));
-        string key(klen, '\0');
-        in.read(&key[0], klen);
+        auto footer = nodeFooters.acquire(static_cast<int>(location.chunk), nodeChunkPath(location.chunk), reader.header().count);
+        if (footer)
+        {
+            vector<uint32_t> offsets = footer->find(hashNodeId(nodeId));
+            if (find(offsets.begin(), offsets.end(), location.offset) == offsets.end())
+                return false;
+        }
+    }
 
-        PropertyValue val = PropertyValue::deserialize(in);
-        properties[key] = val;
+    reader.seek(location.offset);
+    NodeView node = reader.readNodeView();
+    return reader.good() && node.id == nodeId;
+}
+
+string Storage::readNodeId(const NodeLocation &location)
+{
+    auto mapping = nodeChunks.acquire(static_cast<int>(location.chunk), nodeChunkPath(location.chunk));
+    if (!mapping)
+        return {};
+
+    ChunkReader reader(*mapping, &dictionaries);
+    if (!reader.valid())
+        return {};
+    reader.seek(location.offset);
+    NodeView node = reader.readNodeView();
+    return reader.good() ? string(node.id) : string();
+}
+
+size_t Storage::findNode(string_view nodeId)
+{
+    return nodeIndex.find(NodeIndex::hashId(nodeId), [&](const NodeLocation &location)
+                          { return isNodeAt(location, nodeId); });
+}
+
+bool Storage::placeNode(string_view nodeId, NodeLocation location)
+{
+    uint64_t hash = NodeIndex::hashId(nodeId);
+    size_t slot = nodeIndex.find(hash, [&](const NodeLocation &known)
+                                 { return isNodeAt(known, nodeId); });
+    if (slot != NodeIndex::NONE)
+    {
+        nodeIndex.assign(slot, location);
+        return false;
     }
+    nodeIndex.insert(hash, location);
+    return true;
+}
 
-    in.close();
+// ====================== LOAD NODE BY ID ======================
+Node Storage::loadNodeById(const string &nodeId)
+{
+    lock_guard<recursive_mutex> lock(storageMutex);
+
+    // Logged changes shadow whatever the chunks hold
+    auto pending = pendingNodes.find(nodeId);
+    if (pending != pendingNodes.end())
+        return pending->second;
+    if (pendingNodeDeletes.count(nodeId))
+        throw runtime_error("NodeID not found in index: " + nodeId);
+
+    // Cached copies are dropped whenever their id is written or deleted, so they are live
+    if (const Node *cached = nodeCache.get(nodeId))
+        return *cached;
 
+    // Each record filed under the id's hash is decoded until one carries the id
     Node node;
-    node.id = id;
-    node.properties = properties;
+    size_t slot = nodeIndex.find(NodeIndex::hashId(nodeId), [&](const NodeLocation &location)
+                                 {
+        string file = nodeChunkPath(location.chunk);
+        auto mapping = mapChunk(file);
+        if (!mapping)
+        {
+            throw runtime_error("Cannot open file: " + file);
+        }
+
+        // Decode straight from the mapped chunk
+        ChunkReader reader(*mapping, &dictionaries);
+        if (!reader.valid())
+        {
+            throw runtime_error("Unsupported chunk format: " + file);
+        }
 
+        reader.seek(location.offset);
+        node = reader.readNode();
+        if (!reader.good())
+        {
+            throw runtime_error("Truncated node record in " + file + " for " + nodeId);
+        }
+        return node.id == nodeId; });
+
+    if (slot == NodeIndex::NONE)
+    {
+        throw runtime_error("NodeID not found in index: " + nodeId);
+    }
+
+    nodeCache.put(node);
     return node;
 }
 
+bool Storage::containsNode(const string &nodeId)
+{
+    lock_guard<recursive_mutex> lock(storageMutex);
+
+    if (pendingNodes.count(nodeId))
+        return true;
+    if (pendingNodeDeletes.count(nodeId) || !nodeFilter.mayContain(NodeIndex::hashId(nodeId)))
+        return false;
+    // A filter hit may be a false positive
+    return findNode(nodeId) != NodeIndex::NONE;
+}
+
 // ====================== Load edges from node ======================
 vector<Edge> Storage::loadEdgesFromNode(const string &nodeId)
 {
+    lock_guard<recursive_mutex> lock(storageMutex);
+
     vector<Edge> edges;
     auto it = edgeIndex.find(nodeId);
+    auto pending = pendingEdges.find(nodeId);
     if (it == edgeIndex.end())
+        return pending == pendingEdges.end() ? edges : pending->second;
+
+    if (const vector<Edge> *cached = edgeCache.get(nodeId))
+    {
+        edges = *cached;
+        if (pending != pendingEdges.end())
+            edges.insert(edges.end(), pending->second.begin(), pending->second.end());
         return edges;
+    }
+
+    edges = readEdgeRuns(it->second);
+    edgeCache.put(nodeId, edges);
+
+    // Edges still waiting in the memtable are newer than anything on disk
+    if (pending != pendingEdges.end())
+        edges.insert(edges.end(), pending->second.begin(), pending->second.end());
+
+    return edges;
+}
+
+vector<Edge> Storage::readEdgeRuns(const vector<EdgeRun> &runs)
+{
+    vector<Edge> edges;
 
-    for (const auto &[file, offset] : it->second)
+    // Visit the runs chunk by chunk and front to back; each run is one sequential range read.
+    // That is write order: chunks are numbered as they are created, and a reorganization
+    // output takes the number of the oldest of the adjacent chunks it merges.
+    vector<pair<int, const EdgeRun *>> order;
+    order.reserve(runs.size());
+    for (const auto &run : runs)
+        order.emplace_back(chunkNumber(run.file, "edges"), &run);
+    sort(order.begin(), order.end(), [](const auto &a, const auto &b)
+         { return a.first != b.first ? a.first < b.first : a.second->start < b.second->start; });
+
+    for (size_t i = 0; i < order.size();)
     {
-        ifstream in(file, ios::binary);
-        if (!in)
+        const string &file = order[i].second->file;
+        auto mapping = mapChunk(file);
+        if (!mapping)
+        {
+            while (i < order.size() && order[i].second->file == file)
+                ++i;
             continue;
+        }
 
-        in.seekg(offset);
+        ChunkReader reader(*mapping, &dictionaries);
+        for (; i < order.size() && order[i].second->file == file; ++i)
+        {
+            const EdgeRun &run = *order[i].second;
+            if (!reader.valid())
+                continue;
+            reader.prefetch(run.start, run.end - run.start);
 
-        Edge e;
+            reader.seek(run.start);
+            while (reader.good() && reader.tell() < run.end)
+            {
+                Edge e = reader.readEdge();
+                if (reader.good())
+                    edges.push_back(move(e));
+            }
+        }
+    }
 
-        size_t lenFrom;
-        in.read(reinterpret_cast<char *>(&lenFrom), sizeof(lenFrom));
-        e.from.resize(lenFrom);
-        in.read(&e.from[0], lenFrom);
+    return edges;
+}
 
-        size_t lenTo;
-        in.read(reinterpret_cast<char *>(&lenTo), sizeof(lenTo));
-        e.to.resize(lenTo);
-        in.read(&e.to[0], lenTo);
+EdgeListCache::Stats Storage::edgeCacheStats() const
+{
+    lock_guard<recursive_mutex> lock(storageMutex);
+    return edgeCache.stats();
+}
 
-        in.read(reinterpret_cast<char *>(&e.weight), sizeof(e.weight));
+// ====================== CSR SNAPSHOT ======================
+int64_t Storage::sealSnapshot()
+{
+    lock_guard<recursive_mutex> lock(storageMutex);
+
+    // Every live node and every edge endpoint gets a dense id, assigned in sorted id order
+    // The index keeps no ids, so they are read back from the records in file order
+    vector<NodeLocation> locations;
+    locations.reserve(nodeIndex.size());
+    nodeIndex.forEach([&](uint64_t, const NodeLocation &location)
+                      { locations.push_back(location); });
+    sort(locations.begin(), locations.end(), [](const NodeLocation &a, const NodeLocation &b)
+         { return a.chunk != b.chunk ? a.chunk < b.chunk : a.offset < b.offset; });
+
+    vector<string> ids;
+    ids.reserve(nodeIndex.size() + pendingNodes.size());
+    for (const auto &location : locations)
+    {
+        string id = readNodeId(location);
+        if (!id.empty() && !pendingNodeDeletes.count(id))
+            ids.push_back(move(id));
+    }
+    for (const auto &[id, node] : pendingNodes)
+        ids.push_back(id);
+
+    unordered_map<string, vector<Edge>> adjacency;
+    for (const auto &[from, runs] : edgeIndex)
+        adjacency.emplace(from, vector<Edge>());
+    for (const auto &[from, edges] : pendingEdges)
+        adjacency.emplace(from, vector<Edge>());
+
+    // Read straight from the runs: going through loadEdgesFromNode would push every
+    // source through the edge cache and evict the hot set
+    for (auto &[from, edges] : adjacency)
+    {
+        auto runs = edgeIndex.find(from);
+        if (runs != edgeIndex.end())
+            edges = readEdgeRuns(runs->second);
+        auto pending = pendingEdges.find(from);
+        if (pending != pendingEdges.end())
+            edges.insert(edges.end(), pending->second.begin(), pending->second.end());
+
+        ids.push_back(from);
+        for (const auto &e : edges)
+            ids.push_back(e.to);
+    }
 
-        size_t propCount;
-        in.read(reinterpret_cast<char *>(&propCount), sizeof(propCount));
-        for (size_t j = 0; j < propCount; ++j)
-        {
-            size_t klen;
-            in.read(reinterpret_cast<char *>(&klen), sizeof(klen));
-            string key(klen, '\0');
-            in.read(&key[0], klen);
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
+
+    unordered_map<string_view, uint32_t> dense;
+    dense.reserve(ids.size());
+    for (size_t i = 0; i < ids.size(); ++i)
+        dense.emplace(ids[i], static_cast<uint32_t>(i));
 
-            PropertyValue val = PropertyValue::deserialize(in);
-            e.properties[key] = val;
+    vector<uint64_t> offsets;
+    vector<uint32_t> targets;
+    vector<double> weights;
+    offsets.reserve(ids.size() + 1);
+    offsets.push_back(0);
+    for (const auto &id : ids)
+    {
+        auto it = adjacency.find(id);
+        if (it != adjacency.end())
+        {
+            for (const auto &e : it->second)
+            {
+                targets.push_back(dense.at(e.to));
+                weights.push_back(e.weight);
+            }
         }
+        offsets.push_back(targets.size());
+    }
 
-        edges.push_back(e);
+    // The old file may still be mapped, which would block the rename on Windows
+    csrSnapshot.reset();
+    if (!CsrSnapshot::write(SNAPSHOT_PATH, ids, offsets, targets, weights))
+    {
+        printf("sealSnapshot: Cannot write snapshot file: %s\n", SNAPSHOT_PATH.c_str());
+        fflush(stdout);
+        return -1;
     }
 
-    return edges;
+    printf("sealSnapshot: Wrote %zu nodes and %zu edges to %s\n", ids.size(), targets.size(), SNAPSHOT_PATH.c_str());
+    fflush(stdout);
+    return static_cast<int64_t>(targets.size());
+}
+
+shared_ptr<const CsrSnapshot> Storage::snapshot()
+{
+    lock_guard<recursive_mutex> lock(storageMutex);
+
+    if (!csrSnapshot)
+    {
+        auto opened = make_shared<CsrSnapshot>();
+        if (opened->open(SNAPSHOT_PATH))
+            csrSnapshot = opened;
+    }
+    return csrSnapshot;
 }
 
 // ====================== BUILD NODE INDEX ======================
 void Storage::buildNodeIndex()
 {
+    lock_guard<recursive_mutex> lock(storageMutex);
+
     nodeIndex.clear();
+    nodeFilter.reset(0);
+    nodeCache.clear();
 
     fs::path folder = fs::path(NODES_BASE_PATH);
 
@@ -658,61 +1526,203 @@ void Storage::buildNodeIndex()
         return;
     }
 
+    vector<fs::path> files;
     for (const auto &entry : fs::directory_iterator(folder))
     {
-        if (entry.path().extension() != ".bin")
-            continue;
+        if (entry.path().extension() == ".bin")
+            files.push_back(entry.path());
+    }
+    indexNodeChunks(files);
+    rebuildNodeFilter();
+
+    printf("Built node index for %zu NodeIDs\n", nodeIndex.size());
+    fflush(stdout);
+}
+
+void Storage::indexNodeChunks(const vector<fs::path> &files)
+{
+    vector<fs::path> ordered = files;
+    sort(ordered.begin(), ordered.end(), [](const fs::path &a, const fs::path &b)
+         { return chunkNumber(a, "nodes") < chunkNumber(b, "nodes"); });
+
+    vector<NodeIndexPart> parts(ordered.size());
+    forEachParallel(ordered.size(), [&](size_t i)
+                    { indexNodeChunk(ordered[i], parts[i]); });
 
-        ifstream in(entry.path(), ios::binary);
-        if (!in)
+    size_t total = nodeIndex.size();
+    for (const auto &part : parts)
+        total += part.size();
+    nodeIndex.reserve(total);
+
+    for (const auto &part : parts)
+    {
+        for (const auto &[hash, location] : part)
         {
-            printf("buildNodeIndex: Cannot open file: %s\n", entry.path().string().c_str());
-            fflush(stdout);
-            continue;
+            // Only a repeated id (or a rare hash collision) finds a slot here, so
+            // reading ids back from the records stays off the common path
+            // An empty id is read back like any other; a damaged chunk can hold many of them
+            // and each must land in the one slot, since nodeFilter takes every hash once
+            optional<string> id;
+            size_t slot = nodeIndex.find(hash, [&](const NodeLocation &known)
+                                         {
+                if (!id)
+                    id = readNodeId(location);
+                return isNodeAt(known, *id); });
+            if (slot != NodeIndex::NONE)
+                nodeIndex.assign(slot, location);
+            else
+                nodeIndex.insert(hash, location);
         }
+    }
+}
+
+void Storage::indexNodeChunk(const fs::path &file, NodeIndexPart &part)
+{
+    auto mapping = mapChunk(file.string());
+    if (!mapping)
+    {
+        printf("buildNodeIndex: Cannot open file: %s\n", file.string().c_str());
+        fflush(stdout);
+        return;
+    }
 
-        size_t nodeCount;
-        in.read(reinterpret_cast<char *>(&nodeCount), sizeof(nodeCount));
+    ChunkReader reader(*mapping, &dictionaries);
+    if (!reader.valid())
+    {
+        printf("buildNodeIndex: Unsupported chunk format: %s\n", file.string().c_str());
+        fflush(stdout);
+        return;
+    }
 
-        size_t offset = sizeof(nodeCount);
+    uint32_t chunk = static_cast<uint32_t>(chunkNumber(file, "nodes"));
+    unordered_set<uint64_t> deadOffsets = TombstoneFile::deadOffsets(file);
+    part.reserve(reader.header().count);
 
-        for (size_t i = 0; i < nodeCount; ++i)
+    // A current footer lists every record, so the chunk itself is not decoded
+    NodeFooter footer;
+    if (footer.open(file, reader.header().count))
+    {
+        for (size_t i = 0; i < footer.size(); ++i)
         {
-            size_t idLen;
-            size_t nodeStartOffset = offset; // <-- początek węzła
-            in.read(reinterpret_cast<char *>(&idLen), sizeof(idLen));
+            if (!deadOffsets.count(footer.offset(i)))
+                part.emplace_back(NodeIndex::slotHash(footer.hash(i)), NodeLocation{chunk, footer.offset(i)});
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < reader.header().count && reader.good(); ++i)
+    {
+        size_t nodeStartOffset = reader.tell(); // <-- początek węzła
+        // Properties are stepped over, never decoded
+        NodeView node = reader.readNodeView();
 
-            string id(idLen, '\0');
-            in.read(&id[0], idLen);
+        if (reader.good() && !deadOffsets.count(nodeStartOffset))
+            part.emplace_back(NodeIndex::hashId(node.id), NodeLocation{chunk, static_cast<uint32_t>(nodeStartOffset)});
+    }
+}
 
-            size_t propCount;
-            in.read(reinterpret_cast<char *>(&propCount), sizeof(propCount));
+void Storage::rebuildNodeFilter()
+{
+    // Twice the current size, so steady growth rarely forces another rebuild.
+    // A filter that cannot take every id would answer misses wrongly, so it
+    // grows until it does.
+    for (size_t capacity = max<size_t>(nodeIndex.size() * 2, 1024);; capacity *= 2)
+    {
+        nodeFilter.reset(capacity);
+        bool complete = true;
+        nodeIndex.forEach([&](uint64_t hash, const NodeLocation &)
+                          { complete = complete && nodeFilter.insert(hash); });
+        if (complete)
+            return;
+    }
+}
 
-            for (size_t j = 0; j < propCount; ++j)
-            {
-                size_t keyLen;
-                in.read(reinterpret_cast<char *>(&keyLen), sizeof(keyLen));
-                in.seekg(keyLen, ios::cur);
+// ====================== LOAD / PERSIST NODE INDEX ======================
+void Storage::loadNodeIndex()
+{
+    lock_guard<recursive_mutex> lock(storageMutex);
 
-                PropertyValue val = PropertyValue::deserialize(in);
-            }
+    NodeIndexFile indexFile;
+    if (!indexFile.read(NODE_INDEX_PATH))
+    {
+        printf("loadNodeIndex: No usable index file at %s, building from chunks.\n", NODE_INDEX_PATH.c_str());
+        fflush(stdout);
+        buildNodeIndex();
+        persistNodeIndex();
+        return;
+    }
 
-            nodeIndex[id] = {entry.path().string(), nodeStartOffset};
+    nodeIndex.clear();
+    nodeCache.clear();
 
-            offset = in.tellg();
-        }
+    // Chunks whose stamp still matches are taken from the index file as they are
+    unordered_set<uint32_t> validChunks;
+    vector<fs::path> staleChunks;
+    for (const auto &entry : fs::directory_iterator(NODES_BASE_PATH))
+    {
+        int chunk = chunkNumber(entry.path(), "nodes");
+        if (chunk < 0)
+            continue;
 
-        in.close();
+        auto recorded = indexFile.chunks.find(static_cast<uint32_t>(chunk));
+        if (recorded != indexFile.chunks.end() && recorded->second == ChunkStamp::of(entry.path()))
+            validChunks.insert(static_cast<uint32_t>(chunk));
+        else
+            staleChunks.push_back(entry.path());
     }
 
-    printf("Built node index for %zu NodeIDs\n", nodeIndex.size());
+    // The file was written from a complete index, so its entries go in without lookups
+    nodeIndex.reserve(indexFile.entries.size());
+    for (const auto &entry : indexFile.entries)
+    {
+        if (validChunks.count(entry.chunk))
+            nodeIndex.insert(entry.hash, {entry.chunk, entry.offset});
+    }
+
+    indexNodeChunks(staleChunks);
+    rebuildNodeFilter();
+
+    printf("loadNodeIndex: Loaded %zu NodeIDs, rescanned %zu changed chunk(s).\n", nodeIndex.size(), staleChunks.size());
     fflush(stdout);
+
+    if (!staleChunks.empty() || validChunks.size() != indexFile.chunks.size())
+        persistNodeIndex();
+}
+
+void Storage::persistNodeIndex()
+{
+    lock_guard<recursive_mutex> lock(storageMutex);
+
+    NodeIndexFile indexFile;
+
+    if (fs::exists(NODES_BASE_PATH))
+    {
+        for (const auto &entry : fs::directory_iterator(NODES_BASE_PATH))
+        {
+            int chunk = chunkNumber(entry.path(), "nodes");
+            if (chunk >= 0)
+                indexFile.chunks[static_cast<uint32_t>(chunk)] = ChunkStamp::of(entry.path());
+        }
+    }
+
+    indexFile.entries.reserve(nodeIndex.size());
+    nodeIndex.forEach([&](uint64_t hash, const NodeLocation &location)
+                      { indexFile.entries.push_back({hash, location.chunk, location.offset}); });
+
+    if (!indexFile.write(NODE_INDEX_PATH))
+    {
+        printf("persistNodeIndex: Cannot write index file: %s\n", NODE_INDEX_PATH.c_str());
+        fflush(stdout);
+    }
 }
 
 // ====================== BUILD EDGE INDEX ======================
 void Storage::buildEdgeIndex()
 {
+    lock_guard<recursive_mutex> lock(storageMutex);
+
     edgeIndex.clear();
+    edgeCache.clear();
 
     fs::path folder = fs::path(EDGES_BASE_PATH);
 
@@ -723,62 +1733,180 @@ void Storage::buildEdgeIndex()
         return;
     }
 
+    vector<fs::path> files;
     for (const auto &entry : fs::directory_iterator(folder))
     {
-        if (entry.path().extension() != ".bin")
-            continue;
+        if (entry.path().extension() == ".bin")
+            files.push_back(entry.path());
+    }
+    indexEdgeChunks(files);
+
+    printf("Built edge index for %zu source nodes\n", edgeIndex.size());
+    fflush(stdout);
+}
 
-        ifstream in(entry.path(), ios::binary);
-        if (!in)
+void Storage::indexEdgeChunks(const vector<fs::path> &files)
+{
+    vector<EdgeIndex> parts(files.size());
+    forEachParallel(files.size(), [&](size_t i)
+                    { indexEdgeChunk(files[i], parts[i]); });
+
+    // Runs of different chunks never touch, so the partial lists are simply concatenated
+    for (auto &part : parts)
+    {
+        for (auto &[from, runs] : part)
         {
-            printf("buildEdgeIndex: Cannot open file: %s\n", entry.path().string().c_str());
-            fflush(stdout);
+            auto &merged = edgeIndex[from];
+            merged.insert(merged.end(), make_move_iterator(runs.begin()), make_move_iterator(runs.end()));
+        }
+    }
+}
+
+void Storage::indexEdgeChunk(const fs::path &file, EdgeIndex &index)
+{
+    auto mapping = mapChunk(file.string());
+    if (!mapping)
+    {
+        printf("buildEdgeIndex: Cannot open file: %s\n", file.string().c_str());
+        fflush(stdout);
+        return;
+    }
+
+    ChunkReader reader(*mapping, &dictionaries);
+    if (!reader.valid())
+    {
+        printf("buildEdgeIndex: Unsupported chunk format: %s\n", file.string().c_str());
+        fflush(stdout);
+        return;
+    }
+
+    unordered_set<uint64_t> deadOffsets = TombstoneFile::deadOffsets(file);
+    string fileName = file.string();
+    // Records are clustered by source, so most of them extend the runs of the previous one
+    string_view lastFrom;
+    vector<EdgeRun> *runs = nullptr;
+
+    for (size_t i = 0; i < reader.header().count && reader.good(); ++i)
+    {
+        size_t startOffset = reader.tell();
+
+        // Properties are stepped over, never decoded
+        EdgeView edge = reader.readEdgeView();
+        if (!reader.good() || deadOffsets.count(startOffset))
             continue;
+
+        if (!runs || edge.from != lastFrom)
+        {
+            auto it = index.try_emplace(string(edge.from)).first;
+            runs = &it->second;
+            lastFrom = it->first;
         }
+        // Consecutive records of the same source merge into one run
+        addEdgeRun(*runs, fileName, startOffset, reader.tell());
+    }
+}
+
+void Storage::addEdgeRun(vector<EdgeRun> &runs, const string &file, size_t start, size_t end)
+{
+    if (!runs.empty() && runs.back().file == file && runs.back().end == start)
+        runs.back().end = end;
+    else
+        runs.push_back({file, start, end});
+}
+
+// ====================== LOAD / PERSIST EDGE INDEX ======================
+void Storage::loadEdgeIndex()
+{
+    lock_guard<recursive_mutex> lock(storageMutex);
+
+    EdgeIndexFile indexFile;
+    if (!indexFile.open(EDGE_INDEX_PATH))
+    {
+        printf("loadEdgeIndex: No usable index file at %s, building from chunks.\n", EDGE_INDEX_PATH.c_str());
+        fflush(stdout);
+        buildEdgeIndex();
+        persistEdgeIndex();
+        return;
+    }
+
+    edgeIndex.clear();
+    edgeCache.clear();
 
-        size_t edgeCount;
-        in.read(reinterpret_cast<char *>(&edgeCount), sizeof(edgeCount));
-        size_t offset = sizeof(edgeCount);
+    // Chunks whose stamp still matches are taken from the index file as they are
+    unordered_map<uint32_t, string> validChunks;
+    vector<fs::path> staleChunks;
+    for (const auto &entry : fs::directory_iterator(EDGES_BASE_PATH))
+    {
+        int chunk = chunkNumber(entry.path(), "edges");
+        if (chunk < 0)
+            continue;
+
+        auto recorded = indexFile.chunks.find(static_cast<uint32_t>(chunk));
+        if (recorded != indexFile.chunks.end() && recorded->second == ChunkStamp::of(entry.path()))
+            validChunks.emplace(static_cast<uint32_t>(chunk), entry.path().string());
+        else
+            staleChunks.push_back(entry.path());
+    }
 
-        for (size_t i = 0; i < edgeCount; ++i)
+    indexFile.forEachSource([&](string_view id, const EdgeRef *refs, size_t refCount)
+    {
+        vector<EdgeRun> *runs = nullptr;
+        for (size_t i = 0; i < refCount; ++i)
         {
-            size_t startOffset = offset;
-
-            // from
-            size_t fromLen;
-            in.read(reinterpret_cast<char *>(&fromLen), sizeof(fromLen));
-            string from(fromLen, '\0');
-            in.read(&from[0], fromLen);
-
-            // to
-            size_t toLen;
-            in.read(reinterpret_cast<char *>(&toLen), sizeof(toLen));
-            string to(toLen, '\0');
-            in.read(&to[0], toLen);
-
-            // weight
-            double weight;
-            in.read(reinterpret_cast<char *>(&weight), sizeof(weight));
-
-            // properties
-            size_t propCount;
-            in.read(reinterpret_cast<char *>(&propCount), sizeof(propCount));
-            for (size_t j = 0; j < propCount; ++j)
-            {
-                size_t keyLen;
-                in.read(reinterpret_cast<char *>(&keyLen), sizeof(keyLen));
-                in.seekg(keyLen, ios::cur);
-                PropertyValue::deserialize(in);
-            }
+            auto chunk = validChunks.find(refs[i].chunk);
+            if (chunk == validChunks.end())
+                continue;
+            if (!runs)
+                runs = &edgeIndex[string(id)];
+            runs->push_back({chunk->second, refs[i].start, refs[i].end});
+        }
+    });
+
+    indexEdgeChunks(staleChunks);
 
-            edgeIndex[from].emplace_back(entry.path().string(), startOffset);
+    printf("loadEdgeIndex: Loaded %zu source nodes, rescanned %zu changed chunk(s).\n", edgeIndex.size(), staleChunks.size());
+    fflush(stdout);
 
-            offset = in.tellg();
+    if (!staleChunks.empty() || validChunks.size() != indexFile.chunks.size())
+        persistEdgeIndex();
+}
+
+void Storage::persistEdgeIndex()
+{
+    lock_guard<recursive_mutex> lock(storageMutex);
+
+    unordered_map<uint32_t, ChunkStamp> chunks;
+    if (fs::exists(EDGES_BASE_PATH))
+    {
+        for (const auto &entry : fs::directory_iterator(EDGES_BASE_PATH))
+        {
+            int chunk = chunkNumber(entry.path(), "edges");
+            if (chunk >= 0)
+                chunks[static_cast<uint32_t>(chunk)] = ChunkStamp::of(entry.path());
         }
+    }
 
-        in.close();
+    unordered_map<string, int> chunkOfPath;
+    vector<pair<string, vector<EdgeRef>>> sources;
+    sources.reserve(edgeIndex.size());
+    for (const auto &[from, runs] : edgeIndex)
+    {
+        vector<EdgeRef> refs;
+        refs.reserve(runs.size());
+        for (const auto &run : runs)
+        {
+            auto known = chunkOfPath.find(run.file);
+            if (known == chunkOfPath.end())
+                known = chunkOfPath.emplace(run.file, chunkNumber(run.file, "edges")).first;
+            if (known->second >= 0)
+                refs.push_back({static_cast<uint32_t>(known->second), 0, run.start, run.end});
+        }
+        sources.emplace_back(from, std::move(refs));
     }
 
-    printf("Built edge index for %zu source nodes\n", edgeIndex.size());
-    fflush(stdout);
-}
\ No newline at end of file
+    if (!EdgeIndexFile::write(EDGE_INDEX_PATH, chunks, std::move(sources)))
+    {
+        printf("persistEdgeIndex: Cannot write index file: %s\n", EDGE_INDEX_PATH.c_str());
+        fflush(stdout);
+    }
+}
@@ -0,0 +1,51 @@
+#include "tombstone_file.hpp"
+#include <fstream>
+
+using namespace std;
+using namespace graphdb;
+
+fs::path TombstoneFile::pathFor(const fs::path &chunkFile)
+{
+    fs::path file = chunkFile;
+    file.replace_extension(".del");
+    return file;
+}
+
+bool TombstoneFile::append(const fs::path &chunkFile, const vector<Tombstone> &tombstones)
+{
+    if (tombstones.empty())
+        return true;
+
+    ofstream out(pathFor(chunkFile), ios::binary | ios::app);
+    if (!out)
+        return false;
+
+    out.write(reinterpret_cast<const char *>(tombstones.data()), tombstones.size() * sizeof(Tombstone));
+    out.close();
+    return !out.fail();
+}
+
+vector<Tombstone> TombstoneFile::read(const fs::path &chunkFile)
+{
+    vector<Tombstone> tombstones;
+
+    ifstream in(pathFor(chunkFile), ios::binary | ios::ate);
+    if (!in)
+        return tombstones;
+
+    // A torn trailing entry (crash during append) is ignored
+    size_t count = static_cast<size_t>(in.tellg()) / sizeof(Tombstone);
+    tombstones.resize(count);
+    in.seekg(0);
+    in.read(reinterpret_cast<char *>(tombstones.data()), count * sizeof(Tombstone));
+    tombstones.resize(static_cast<size_t>(in.gcount()) / sizeof(Tombstone));
+    return tombstones;
+}
+
+unordered_set<uint64_t> TombstoneFile::deadOffsets(const fs::path &chunkFile)
+{
+    unordered_set<uint64_t> offsets;
+    for (const auto &tombstone : read(chunkFile))
+        offsets.insert(tombstone.offset);
+    return offsets;
+}
@@ -0,0 +1,378 @@
+#include "write_ahead_log.hpp"
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <tuple>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace graphdb;
+
+namespace
+{
+    const size_t FRAME_HEADER_SIZE = 2 * sizeof(uint32_t);
+
+    uint32_t crc32(const char *data, size_t length)
+    {
+        static const array<uint32_t, 256> table = []
+        {
+            array<uint32_t, 256> t{};
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                t[i] = c;
+            }
+            return t;
+        }();
+
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = 0; i < length; ++i)
+            crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+        return crc ^ 0xFFFFFFFFu;
+    }
+
+#ifdef _WIN32
+    int openForAppend(const fs::path &file) { return _wopen(file.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE); }
+    int openForSync(const fs::path &file) { return _wopen(file.c_str(), _O_RDWR | _O_BINARY); }
+    int closeFile(int fd) { return _close(fd); }
+    bool syncFd(int fd) { return _commit(fd) == 0; }
+    bool truncateFd(int fd, uint64_t length) { return _chsize_s(fd, static_cast<long long>(length)) == 0; }
+    long long writeFd(int fd, const char *data, size_t length) { return _write(fd, data, static_cast<unsigned int>(length)); }
+#else
+    int openForAppend(const fs::path &file) { return ::open(file.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644); }
+    int openForSync(const fs::path &file) { return ::open(file.c_str(), O_RDWR); }
+    int closeFile(int fd) { return ::close(fd); }
+    bool truncateFd(int fd, uint64_t length) { return ftruncate(fd, static_cast<off_t>(length)) == 0; }
+    long long writeFd(int fd, const char *data, size_t length) { return ::write(fd, data, length); }
+    bool syncFd(int fd)
+    {
+#if defined(__APPLE__)
+        return fsync(fd) == 0;
+#else
+        return fdatasync(fd) == 0;
+#endif
+    }
+#endif
+}
+
+bool graphdb::syncFile(const fs::path &file)
+{
+    int fd = openForSync(file);
+    if (fd < 0)
+        return false;
+    bool ok = syncFd(fd);
+    closeFile(fd);
+    return ok;
+}
+
+WriteAheadLog::~WriteAheadLog()
+{
+    close();
+}
+
+bool WriteAheadLog::open(const fs::path &file)
+{
+    close();
+
+    fd = openForAppend(file);
+    if (fd < 0)
+        return false;
+
+    path = file;
+    error_code ec;
+    bytesOnDisk = fs::file_size(file, ec);
+    if (ec)
+        bytesOnDisk = 0;
+    broken = false;
+    return true;
+}
+
+void WriteAheadLog::close()
+{
+    if (fd >= 0)
+        closeFile(fd);
+    fd = -1;
+}
+
+size_t WriteAheadLog::replay(const function<void(WalRecordType, const string &)> &apply, const WalPosition &skipThrough)
+{
+    lock_guard<mutex> lock(walMutex);
+
+    string buf;
+    {
+        ifstream in(path, ios::binary | ios::ate);
+        if (!in)
+            return 0;
+        buf.resize(static_cast<size_t>(in.tellg()));
+        in.seekg(0);
+        in.read(buf.data(), buf.size());
+        buf.resize(static_cast<size_t>(in.gcount()));
+    }
+
+    // Intact frames as (start, length, crc)
+    vector<tuple<size_t, uint32_t, uint32_t>> frames;
+    size_t pos = 0;
+    while (buf.size() - pos >= FRAME_HEADER_SIZE)
+    {
+        uint32_t length, crc;
+        memcpy(&length, buf.data() + pos, sizeof(length));
+        memcpy(&crc, buf.data() + pos + sizeof(length), sizeof(crc));
+        if (length == 0 || buf.size() - pos - FRAME_HEADER_SIZE < length)
+            break;
+
+        if (crc32(buf.data() + pos + FRAME_HEADER_SIZE, length) != crc)
+            break;
+
+        frames.emplace_back(pos, length, crc);
+        pos += FRAME_HEADER_SIZE + length;
+    }
+
+    // Records a checkpoint already materialized are skipped; a marker that matches no
+    // record boundary belongs to an older log and skips nothing
+    size_t first = 0;
+    for (size_t i = 0; i < frames.size() && skipThrough.end != 0; ++i)
+    {
+        auto [start, length, crc] = frames[i];
+        if (start + FRAME_HEADER_SIZE + length == skipThrough.end && crc == skipThrough.crc)
+            first = i + 1;
+    }
+
+    for (size_t i = first; i < frames.size(); ++i)
+    {
+        auto [start, length, crc] = frames[i];
+        const char *body = buf.data() + start + FRAME_HEADER_SIZE;
+        apply(static_cast<WalRecordType>(body[0]), string(body + 1, length - 1));
+    }
+    if (first > 0)
+    {
+        printf("WriteAheadLog: Skipped %zu record(s) already in the chunks\n", first);
+        fflush(stdout);
+    }
+
+    // Whatever follows the last intact record is a write that never completed
+    if (pos != buf.size())
+    {
+        printf("WriteAheadLog: Dropping %zu bytes of torn tail from %s\n", buf.size() - pos, path.string().c_str());
+        fflush(stdout);
+        truncateFd(fd, pos);
+        syncFd(fd);
+    }
+    bytesOnDisk = pos;
+    lastDurableCrc = frames.empty() ? 0 : get<2>(frames.back());
+    lastQueuedCrc = lastDurableCrc;
+    return frames.size() - first;
+}
+
+uint64_t WriteAheadLog::append(WalRecordType type, const string &payload)
+{
+    uint32_t length = static_cast<uint32_t>(payload.size() + 1);
+
+    string body;
+    body.reserve(length);
+    body.push_back(static_cast<char>(type));
+    body.append(payload);
+    uint32_t crc = crc32(body.data(), body.size());
+
+    lock_guard<mutex> lock(walMutex);
+    queued.append(reinterpret_cast<const char *>(&length), sizeof(length));
+    queued.append(reinterpret_cast<const char *>(&crc), sizeof(crc));
+    queued.append(body);
+    lastQueuedCrc = crc;
+    return ++nextTicket;
+}
+
+bool WriteAheadLog::waitDurable(uint64_t ticket)
+{
+    unique_lock<mutex> lock(walMutex);
+    auto discarded = [&] { return ticket > discardedAfter && ticket <= discardedThrough; };
+    while (durableTicket < ticket && !broken && !discarded())
+    {
+        if (flushing)
+        {
+            durableChanged.wait(lock);
+            continue;
+        }
+
+        // Become the leader: everything queued so far goes out in one write + sync
+        flushing = true;
+        string batch;
+        batch.swap(queued);
+        uint64_t upTo = nextTicket;
+        uint32_t batchCrc = lastQueuedCrc;
+
+        lock.unlock();
+        bool ok = writeAndSync(batch);
+        lock.lock();
+
+        flushing = false;
+        if (ok)
+        {
+            durableTicket = upTo;
+            bytesOnDisk += batch.size();
+            if (!batch.empty())
+                lastDurableCrc = batchCrc;
+        }
+        else
+        {
+            broken = true;
+        }
+        durableChanged.notify_all();
+    }
+    return durableTicket >= ticket && !discarded();
+}
+
+bool WriteAheadLog::flush()
+{
+    uint64_t ticket;
+    {
+        lock_guard<mutex> lock(walMutex);
+        ticket = nextTicket;
+    }
+    return waitDurable(ticket);
+}
+
+bool WriteAheadLog::failed() const
+{
+    lock_guard<mutex> lock(walMutex);
+    return broken;
+}
+
+bool WriteAheadLog::discardUndurable()
+{
+    unique_lock<mutex> lock(walMutex);
+    durableChanged.wait(lock, [this] { return !flushing; });
+
+    // A failed write may have left part of its batch behind the durable records
+    if (!truncateFd(fd, bytesOnDisk) || !syncFd(fd))
+        return false;
+
+    queued.clear();
+    lastQueuedCrc = lastDurableCrc;
+    discardedAfter = durableTicket;
+    discardedThrough = nextTicket;
+    broken = false;
+    durableChanged.notify_all();
+    return true;
+}
+
+bool WriteAheadLog::reset()
+{
+    unique_lock<mutex> lock(walMutex);
+    durableChanged.wait(lock, [this] { return !flushing; });
+
+    // Records lost by a failed write must be rolled back before the log moves on
+    if (broken)
+        return false;
+
+    if (!queued.empty())
+    {
+        if (!writeAndSync(queued))
+        {
+            broken = true;
+            return false;
+        }
+        queued.clear();
+        durableTicket = nextTicket;
+        durableChanged.notify_all();
+    }
+
+    if (!truncateFd(fd, 0) || !syncFd(fd))
+        return false;
+
+    bytesOnDisk = 0;
+    lastDurableCrc = 0;
+    lastQueuedCrc = 0;
+    return true;
+}
+
+uint64_t WriteAheadLog::size() const
+{
+    lock_guard<mutex> lock(walMutex);
+    return bytesOnDisk + queued.size();
+}
+
+WalPosition WriteAheadLog::position() const
+{
+    lock_guard<mutex> lock(walMutex);
+    return {bytesOnDisk, lastDurableCrc};
+}
+
+bool WriteAheadLog::writeAndSync(const string &batch)
+{
+    if (fd < 0)
+        return false;
+
+    size_t written = 0;
+    while (written < batch.size())
+    {
+        long long n = writeFd(fd, batch.data() + written, batch.size() - written);
+        if (n <= 0)
+            return false;
+        written += static_cast<size_t>(n);
+    }
+    return syncFd(fd);
+}
+
+bool CheckpointMarker::read(const fs::path &file)
+{
+    *this = CheckpointMarker{};
+    ifstream in(file);
+    if (!in)
+        return true;
+
+    string kind;
+    while (in >> kind)
+    {
+        if (kind == "materialized")
+            in >> materialized.end >> materialized.crc;
+        else if (kind == "appending")
+            in >> appending.end >> appending.crc;
+        else if (kind == "edges")
+        {
+            in >> edgeSize >> edgeCount;
+            getline(in >> ws, edgeFile);
+        }
+        else
+            return false;
+        if (!in)
+            return false;
+    }
+    return true;
+}
+
+bool CheckpointMarker::write(const fs::path &file) const
+{
+    fs::path tmp = file;
+    tmp += ".tmp";
+    {
+        ofstream out(tmp, ios::trunc);
+        out << "materialized " << materialized.end << " " << materialized.crc << "\n";
+        if (inFlight())
+        {
+            out << "appending " << appending.end << " " << appending.crc << "\n";
+            if (!edgeFile.empty())
+                out << "edges " << edgeSize << " " << edgeCount << " " << edgeFile << "\n";
+        }
+        out.close();
+        if (out.fail())
+            return false;
+    }
+    if (!syncFile(tmp))
+        return false;
+
+    error_code ec;
+    fs::rename(tmp, file, ec);
+    return !ec;
+}